@@ -0,0 +1,151 @@
+#ifndef BENCHPLUGIN_H
+#define BENCHPLUGIN_H
+
+#include <string.h>
+#include <math.h>
+#include "../../vstsdk/aeffectx.h"
+
+#if defined(_WIN32)
+#define BENCH_EXPORT extern "C" __declspec(dllexport)
+#else
+#define BENCH_EXPORT extern "C" __attribute__((visibility("default")))
+#endif
+
+// minimal VST2 effect around a kernel, every test plugin is one kernel built as its own shared library:
+// struct Kernel
+// {
+//	enum { Id, Inputs, Outputs, Params, Tail, Generator };
+//	static const char * name();
+//	float params[Params]; // 0..1, set before reset()
+//	void reset(float samplerate, int blocksize); // effMainsChanged on, allocations go here
+//	template <class T> void process(T ** in, T ** out, int count);
+// };
+template <class Kernel>
+struct BenchEffect
+{
+	AEffect effect;
+	Kernel kernel;
+	float samplerate;
+	int blocksize;
+	BenchEffect(): samplerate(44100), blocksize(1024)
+	{
+		memset(& effect, 0, sizeof(effect));
+		effect.magic = kEffectMagic;
+		effect.dispatcher = dispatcher;
+		effect.setParameter = setParameter;
+		effect.getParameter = getParameter;
+		effect.processReplacing = processReplacing;
+		effect.processDoubleReplacing = processDoubleReplacing;
+		effect.numPrograms = 1;
+		effect.numParams = Kernel::Params;
+		effect.numInputs = Kernel::Inputs;
+		effect.numOutputs = Kernel::Outputs;
+		effect.flags = effFlagsCanReplacing | effFlagsCanDoubleReplacing;
+		effect.uniqueID = Kernel::Id;
+		effect.version = 1;
+		effect.object = this;
+		kernel.reset(samplerate, blocksize);
+	}
+	static BenchEffect * self(AEffect * e)
+	{
+		return (BenchEffect *)e->object;
+	}
+
+// AEffect callbacks
+	static VstIntPtr VSTCALLBACK dispatcher(AEffect * e, VstInt32 opcode, VstInt32 index, VstIntPtr value, void * ptr, float opt)
+	{
+		BenchEffect * b = self(e);
+		switch (opcode)
+		{
+		case effClose:
+			delete b;
+			return 1;
+		case effSetSampleRate:
+			b->samplerate = opt;
+			return 0;
+		case effSetBlockSize:
+			b->blocksize = (int)value;
+			return 0;
+		case effMainsChanged:
+			if (value)
+			{
+				b->kernel.reset(b->samplerate, b->blocksize);
+			}
+			return 0;
+		case effGetParamName:
+			vst_strncpy((char *)ptr, "param", kVstMaxParamStrLen);
+			return 0;
+		case effGetParamDisplay:
+			if (index >= 0 && index < Kernel::Params)
+			{
+				float2string(b->kernel.params[index], (char *)ptr, kVstMaxParamStrLen);
+			}
+			return 0;
+		case effGetEffectName:
+		case effGetProductString:
+			vst_strncpy((char *)ptr, Kernel::name(), kVstMaxEffectNameLen);
+			return 1;
+		case effGetVendorString:
+			vst_strncpy((char *)ptr, "QVstHost bench", kVstMaxVendorStrLen);
+			return 1;
+		case effGetPlugCategory:
+			return Kernel::Generator ? kPlugCategGenerator : kPlugCategEffect;
+		case effGetTailSize:
+			return Kernel::Tail;
+		case effGetVstVersion:
+			return kVstVersion;
+		case effSetProcessPrecision:
+			return 1;
+		}
+		return 0;
+	}
+	static void VSTCALLBACK setParameter(AEffect * e, VstInt32 index, float value)
+	{
+		if (index >= 0 && index < Kernel::Params)
+		{
+			self(e)->kernel.params[index] = value;
+		}
+	}
+	static float VSTCALLBACK getParameter(AEffect * e, VstInt32 index)
+	{
+		return (index >= 0 && index < Kernel::Params) ? self(e)->kernel.params[index] : 0.0f;
+	}
+	static void VSTCALLBACK processReplacing(AEffect * e, float ** in, float ** out, VstInt32 count)
+	{
+		self(e)->kernel.process(in, out, count);
+	}
+	static void VSTCALLBACK processDoubleReplacing(AEffect * e, double ** in, double ** out, VstInt32 count)
+	{
+		self(e)->kernel.process(in, out, count);
+	}
+	static void float2string(float value, char * text, int size)
+	{
+		const int n = (int)(value * 100.0f + 0.5f);
+		char s[16];
+		int i = 0;
+		s[i++] = (char)('0' + (n / 100) % 10);
+		s[i++] = '.';
+		s[i++] = (char)('0' + (n / 10) % 10);
+		s[i++] = (char)('0' + n % 10);
+		s[i] = 0;
+		vst_strncpy(text, s, size);
+	}
+};
+
+template <class Kernel>
+AEffect * createBenchEffect(audioMasterCallback host)
+{
+	if (!host || !host(0, audioMasterVersion, 0, 0, 0, 0))
+	{
+		return 0;
+	}
+	return & (new BenchEffect<Kernel>())->effect;
+}
+
+#define BENCH_PLUGIN(Kernel) \
+	BENCH_EXPORT AEffect * VSTPluginMain(audioMasterCallback host) \
+	{ \
+		return createBenchEffect<Kernel>(host); \
+	}
+
+#endif // BENCHPLUGIN_H
@@ -0,0 +1,64 @@
+#include "benchplugin.h"
+#include <vector>
+
+// stereo feedback delay: time 0..1 s, feedback 0..0.95, mix
+struct DelayKernel
+{
+	enum { Id = 0x51626e32, Inputs = 2, Outputs = 2, Params = 3, Tail = 0, Generator = 0 };
+	float params[Params];
+	std::vector<double> ring[Outputs];
+	int pos;
+	DelayKernel(): pos(0)
+	{
+		params[0] = 0.25f;
+		params[1] = 0.5f;
+		params[2] = 0.5f;
+	}
+	static const char * name()
+	{
+		return "bench delay";
+	}
+	void reset(float samplerate, int)
+	{
+		for (int c = 0; c < Outputs; c++)
+		{
+			ring[c].assign((size_t)samplerate + 1, 0.0);
+		}
+		pos = 0;
+	}
+	template <class T>
+	void process(T ** in, T ** out, int count)
+	{
+		const int size = (int)ring[0].size();
+		const int delay = 1 + (int)(params[0] * (size - 2));
+		const double feedback = params[1] * 0.95;
+		const double mix = params[2];
+		int p = pos;
+		for (int c = 0; c < Outputs; c++)
+		{
+			double * r = & ring[c][0];
+			const T * i = in[c];
+			T * o = out[c];
+			p = pos;
+			for (int n = 0; n < count; n++)
+			{
+				int tap = p - delay;
+				if (tap < 0)
+				{
+					tap += size;
+				}
+				const double x = i[n];
+				const double y = r[tap];
+				r[p] = x + y * feedback;
+				o[n] = (T)(x + (y - x) * mix);
+				if (++p == size)
+				{
+					p = 0;
+				}
+			}
+		}
+		pos = p;
+	}
+};
+
+BENCH_PLUGIN(DelayKernel)
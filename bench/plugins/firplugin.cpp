@@ -0,0 +1,68 @@
+#include "benchplugin.h"
+#include <vector>
+
+// stereo 1024 taps windowed sinc lowpass, direct form, a heavy but steady per-sample cost
+struct FirKernel
+{
+	enum { Id = 0x51626e33, Inputs = 2, Outputs = 2, Params = 1, Tail = 1024, Generator = 0, Taps = 1024 };
+	float params[Params];
+	std::vector<double> taps;
+	std::vector<double> history[Outputs]; // doubled so a tap window never wraps
+	int pos;
+	FirKernel(): pos(0)
+	{
+		params[0] = 0.25f;
+	}
+	static const char * name()
+	{
+		return "bench fir";
+	}
+	void reset(float, int)
+	{
+		const double pi = 3.14159265358979323846;
+		const double cutoff = 0.01 + params[0] * 0.48;
+		taps.resize(Taps);
+		for (int k = 0; k < Taps; k++)
+		{
+			const double m = k - (Taps - 1) * 0.5;
+			const double sinc = (m == 0.0) ? 2.0 * cutoff : sin(2.0 * pi * cutoff * m) / (pi * m);
+			const double window = 0.42 - 0.5 * cos(2.0 * pi * k / (Taps - 1)) + 0.08 * cos(4.0 * pi * k / (Taps - 1));
+			taps[k] = sinc * window;
+		}
+		for (int c = 0; c < Outputs; c++)
+		{
+			history[c].assign(2 * Taps, 0.0);
+		}
+		pos = 0;
+	}
+	template <class T>
+	void process(T ** in, T ** out, int count)
+	{
+		int p = pos;
+		for (int c = 0; c < Outputs; c++)
+		{
+			double * h = & history[c][0];
+			const T * i = in[c];
+			T * o = out[c];
+			p = pos;
+			for (int n = 0; n < count; n++)
+			{
+				h[p] = h[p + Taps] = i[n];
+				const double * w = h + p + 1;
+				double acc = 0.0;
+				for (int k = 0; k < Taps; k++)
+				{
+					acc += w[k] * taps[Taps - 1 - k];
+				}
+				o[n] = (T)acc;
+				if (++p == Taps)
+				{
+					p = 0;
+				}
+			}
+		}
+		pos = p;
+	}
+};
+
+BENCH_PLUGIN(FirKernel)
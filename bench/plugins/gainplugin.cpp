@@ -0,0 +1,35 @@
+#include "benchplugin.h"
+
+// stereo gain, 0..1 maps to -inf..+6 dB
+struct GainKernel
+{
+	enum { Id = 0x51626e31, Inputs = 2, Outputs = 2, Params = 1, Tail = 1, Generator = 0 };
+	float params[Params];
+	GainKernel()
+	{
+		params[0] = 0.5f;
+	}
+	static const char * name()
+	{
+		return "bench gain";
+	}
+	void reset(float, int)
+	{
+	}
+	template <class T>
+	void process(T ** in, T ** out, int count)
+	{
+		const T g = T(params[0] * 2.0f);
+		for (int c = 0; c < Outputs; c++)
+		{
+			const T * i = in[c];
+			T * o = out[c];
+			for (int n = 0; n < count; n++)
+			{
+				o[n] = i[n] * g;
+			}
+		}
+	}
+};
+
+BENCH_PLUGIN(GainKernel)
@@ -0,0 +1,41 @@
+#include "benchplugin.h"
+
+// stereo sine generator, frequency 20 Hz..20 kHz logarithmic, no inputs
+struct GeneratorKernel
+{
+	enum { Id = 0x51626e34, Inputs = 0, Outputs = 2, Params = 1, Tail = 0, Generator = 1 };
+	float params[Params];
+	double phase;
+	double step;
+	float samplerate;
+	GeneratorKernel(): phase(0), step(0), samplerate(44100)
+	{
+		params[0] = 0.446f; // ~440 Hz
+	}
+	static const char * name()
+	{
+		return "bench generator";
+	}
+	void reset(float sr, int)
+	{
+		samplerate = sr;
+		phase = 0;
+	}
+	template <class T>
+	void process(T **, T ** out, int count)
+	{
+		const double pi = 3.14159265358979323846;
+		step = 2.0 * pi * 20.0 * pow(1000.0, (double)params[0]) / samplerate;
+		for (int n = 0; n < count; n++)
+		{
+			out[0][n] = out[1][n] = (T)(0.5 * sin(phase));
+			phase += step;
+			if (phase > 2.0 * pi)
+			{
+				phase -= 2.0 * pi;
+			}
+		}
+	}
+};
+
+BENCH_PLUGIN(GeneratorKernel)
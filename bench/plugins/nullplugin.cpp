@@ -0,0 +1,28 @@
+#include "benchplugin.h"
+
+// stereo pass-through, the host overhead baseline
+struct NullKernel
+{
+	enum { Id = 0x51626e30, Inputs = 2, Outputs = 2, Params = 0, Tail = 1, Generator = 0 };
+	float params[1];
+	static const char * name()
+	{
+		return "bench null";
+	}
+	void reset(float, int)
+	{
+	}
+	template <class T>
+	void process(T ** in, T ** out, int count)
+	{
+		for (int c = 0; c < Outputs; c++)
+		{
+			if (out[c] != in[c])
+			{
+				memcpy(out[c], in[c], count * sizeof(T));
+			}
+		}
+	}
+};
+
+BENCH_PLUGIN(NullKernel)
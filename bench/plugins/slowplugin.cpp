@@ -0,0 +1,55 @@
+#include "benchplugin.h"
+
+// deliberately bad plugin: a resonant IIR whose tail decays into denormals with no flushing,
+// plus a busy loop of 0..1000 iterations per sample
+struct SlowKernel
+{
+	enum { Id = 0x51626e35, Inputs = 2, Outputs = 2, Params = 2, Tail = 0, Generator = 0 };
+	float params[Params];
+	float state[Outputs][2]; // single precision on purpose, reaches the denormal range within ~100k samples
+	SlowKernel()
+	{
+		params[0] = 0.0f;
+		params[1] = 0.999f;
+		memset(state, 0, sizeof(state));
+	}
+	static const char * name()
+	{
+		return "bench slow";
+	}
+	void reset(float, int)
+	{
+		memset(state, 0, sizeof(state));
+	}
+	template <class T>
+	void process(T ** in, T ** out, int count)
+	{
+		const int spin = (int)(params[0] * 1000.0f);
+		const float r = params[1];
+		const float a1 = 2.0f * r * (float)cos(0.05);
+		const float a2 = -r * r;
+		volatile double sink = 0.0;
+		for (int c = 0; c < Outputs; c++)
+		{
+			const T * i = in[c];
+			T * o = out[c];
+			float y1 = state[c][0];
+			float y2 = state[c][1];
+			for (int n = 0; n < count; n++)
+			{
+				const float y = (float)i[n] * (1.0f - r) + a1 * y1 + a2 * y2;
+				y2 = y1;
+				y1 = y;
+				o[n] = (T)y;
+				for (int k = 0; k < spin; k++)
+				{
+					sink = sink * 0.5 + k;
+				}
+			}
+			state[c][0] = y1;
+			state[c][1] = y2;
+		}
+	}
+};
+
+BENCH_PLUGIN(SlowKernel)
@@ -0,0 +1,276 @@
+// host overhead benchmark over the bench plugins (bench/plugins/*plugin.cpp, each built as a shared library bench_<kind>)
+// and over in process QVstMock effects, which need no plugin binaries
+// usage: qvsthostbench [plugins directory] [milliseconds per case]
+// prints CSV: case,plugin,precision,block,channels,chain,calls,ns_per_call,ns_per_sample
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QStringList>
+#include <QDir>
+#include <stdio.h>
+#include "../qvsthost.h"
+#include "../qvstfanout.h"
+#include "../qvstmock.h"
+
+// one call of the measured entry point
+struct Runner
+{
+	virtual ~Runner()
+	{
+	}
+	virtual bool run() = 0;
+};
+
+template <class T>
+static void noise(T * p, int count, quint32 & seed)
+{
+	for (int n = 0; n < count; n++)
+	{
+		seed = seed * 1664525u + 1013904223u;
+		p[n] = T((qint32)seed) / T(2147483648.0) * T(0.25);
+	}
+}
+
+template <class T>
+struct RawRunner: public Runner
+{
+	QVstPlugin vst;
+	QVstAudioBuffer<T> in;
+	QVstAudioBuffer<T> out;
+	QVector<const T *> src;
+	QVector<T *> dst;
+	int block;
+	RawRunner(const QVstPlugin & v, int b): vst(v), in(v.inputsCount(), b), out(v.outputsCount(), b), src(v.inputsCount()), dst(v.outputsCount()), block(b)
+	{
+		quint32 seed = 1;
+		for (int k = 0; k < src.count(); k++)
+		{
+			noise(in.channel(k), block, seed);
+			src[k] = in.channel(k);
+		}
+		for (int k = 0; k < dst.count(); k++)
+		{
+			dst[k] = out.channel(k);
+		}
+	}
+	bool run()
+	{
+		return vst.process(src.data(), dst.data(), block);
+	}
+};
+
+template <class T>
+struct ListRunner: public Runner
+{
+	QVstPlugin vst;
+	QList< QVector<T> > in;
+	ListRunner(const QVstPlugin & v, int b): vst(v)
+	{
+		quint32 seed = 1;
+		for (int k = 0; k < v.inputsCount(); k++)
+		{
+			in << QVector<T>(b);
+			noise(in.back().data(), b, seed);
+		}
+	}
+	bool run()
+	{
+		return (vst.process(in).count() == vst.outputsCount());
+	}
+};
+
+template <class T>
+struct ChainRunner: public Runner
+{
+	QVstChain chain;
+	QVstAudioBuffer<T> in;
+	QVstAudioBuffer<T> out;
+	QVector<const T *> src;
+	QVector<T *> dst;
+	int block;
+	ChainRunner(const QVstChain & c, int channels, int b): chain(c), in(channels, b), out(channels, b), src(channels), dst(channels), block(b)
+	{
+		quint32 seed = 1;
+		for (int k = 0; k < channels; k++)
+		{
+			noise(in.channel(k), block, seed);
+			src[k] = in.channel(k);
+			dst[k] = out.channel(k);
+		}
+	}
+	bool run()
+	{
+		return chain.process(src.data(), dst.data(), src.count(), block);
+	}
+};
+
+struct Result
+{
+	qint64 calls;
+	qint64 nsecs;
+};
+
+static Result measure(Runner & r, qint64 budget_ns)
+{
+	Result res = { 0, 0 };
+	for (int i = 0; i < 16; i++)
+	{
+		if (!r.run())
+		{
+			return res;
+		}
+	}
+	QElapsedTimer timer;
+	timer.start();
+	int batch = 1;
+	while (res.nsecs < budget_ns)
+	{
+		for (int i = 0; i < batch; i++)
+		{
+			r.run();
+		}
+		res.calls += batch;
+		res.nsecs = timer.nsecsElapsed();
+		batch = qMin(batch * 2, 4096);
+	}
+	return res;
+}
+
+static void report(const char * name, const QString & plugin, int precision, int block, int channels, int chain, const Result & r)
+{
+	if (r.calls == 0)
+	{
+		fprintf(stderr, "%s %s: process failed\n", name, qPrintable(plugin));
+		return;
+	}
+	const double per_call = (double)r.nsecs / r.calls;
+	const double per_sample = per_call / ((double)block * qMax(1, channels));
+	printf("%s,%s,%d,%d,%d,%d,%lld,%.1f,%.3f\n", name, qPrintable(plugin), precision, block, channels, chain, r.calls, per_call, per_sample);
+	fflush(stdout);
+}
+
+// 64 bits - prepared for processDoubleReplacing, so double runners don't time the float conversion
+static void prepare(QVstPlugin & vst, int block, int precision)
+{
+	vst.suspend();
+	vst.setSampleRate(48000);
+	vst.setBlockSize(block);
+	vst.setDoublePrecision(precision == 64);
+	vst.resume();
+}
+
+static void prepare(QVstChain & chain, int block, int precision)
+{
+	chain.suspend();
+	chain.setSampleRate(48000);
+	chain.setBlockSize(block);
+	chain.setDoublePrecision(precision == 64);
+	chain.resume();
+}
+
+int main(int argc, char ** argv)
+{
+	QCoreApplication app(argc, argv);
+	const QStringList args = app.arguments();
+	const QString dir = args.count() > 1 ? args[1] : app.applicationDirPath();
+	const qint64 budget = (args.count() > 2 ? args[2].toLongLong() : 200) * 1000000;
+	const int blocks[] = { 16, 64, 256, 1024, 4096 };
+	const int blocks_count = sizeof(blocks) / sizeof(blocks[0]);
+	QStringList plugins;
+	plugins << "null" << "gain" << "delay" << "fir" << "generator" << "slow";
+
+	printf("case,plugin,precision,block,channels,chain,calls,ns_per_call,ns_per_sample\n");
+	foreach (const QString & kind, plugins)
+	{
+		const QString path = QDir(dir).filePath("bench_" + kind);
+		for (int b = 0; b < blocks_count; b++)
+		{
+			QVstPlugin vst(path);
+			if (!vst.isLoaded())
+			{
+				fprintf(stderr, "can't load %s\n", qPrintable(path));
+				break;
+			}
+			const int channels = vst.outputsCount();
+			prepare(vst, blocks[b], 32);
+			{
+				RawRunner<float> r(vst, blocks[b]);
+				report("plugin_raw", kind, 32, blocks[b], channels, 1, measure(r, budget));
+			}
+			{
+				ListRunner<float> r(vst, blocks[b]);
+				report("plugin_list", kind, 32, blocks[b], channels, 1, measure(r, budget));
+			}
+			prepare(vst, blocks[b], 64);
+			{
+				RawRunner<double> r(vst, blocks[b]);
+				report("plugin_raw", kind, 64, blocks[b], channels, 1, measure(r, budget));
+			}
+			{
+				ListRunner<double> r(vst, blocks[b]);
+				report("plugin_list", kind, 64, blocks[b], channels, 1, measure(r, budget));
+			}
+		}
+	}
+
+	// channel counts: N null instances side by side
+	const int instances[] = { 1, 4, 16 };
+	for (int i = 0; i < (int)(sizeof(instances) / sizeof(instances[0])); i++)
+	{
+		for (int b = 0; b < blocks_count; b++)
+		{
+			QVstPlugin vst = QVstFanOut::create(QDir(dir).filePath("bench_null"), instances[i], QString(), -1);
+			if (!vst.isLoaded())
+			{
+				break;
+			}
+			prepare(vst, blocks[b], 32);
+			RawRunner<float> r(vst, blocks[b]);
+			report("fanout_raw", "null", 32, blocks[b], vst.outputsCount(), 1, measure(r, budget));
+		}
+	}
+
+	// chain lengths
+	const int lengths[] = { 1, 4, 16 };
+	for (int i = 0; i < (int)(sizeof(lengths) / sizeof(lengths[0])); i++)
+	{
+		for (int b = 0; b < blocks_count; b++)
+		{
+			QVstChain chain;
+			for (int k = 0; k < lengths[i]; k++)
+			{
+				chain << QVstPlugin(QDir(dir).filePath("bench_null"));
+			}
+			if (chain.isEmpty() || !chain.front().isLoaded())
+			{
+				break;
+			}
+			prepare(chain, blocks[b], 32);
+			{
+				ChainRunner<float> r(chain, 2, blocks[b]);
+				report("chain_raw", "null", 32, blocks[b], 2, lengths[i], measure(r, budget));
+			}
+			prepare(chain, blocks[b], 64);
+			{
+				ChainRunner<double> r(chain, 2, blocks[b]);
+				report("chain_raw", "null", 64, blocks[b], 2, lengths[i], measure(r, budget));
+			}
+		}
+	}
+
+	// chain lengths over mocks
+	for (int i = 0; i < (int)(sizeof(lengths) / sizeof(lengths[0])); i++)
+	{
+		for (int b = 0; b < blocks_count; b++)
+		{
+			QVstChain chain;
+			for (int k = 0; k < lengths[i]; k++)
+			{
+				chain << QVstMock::create();
+			}
+			prepare(chain, blocks[b], 32);
+			ChainRunner<float> r(chain, 2, blocks[b]);
+			report("chain_mock", "mock", 32, blocks[b], 2, lengths[i], measure(r, budget));
+		}
+	}
+	return 0;
+}
@@ -0,0 +1,188 @@
+#ifndef QVSTAUDIOBUFFER_H
+#define QVSTAUDIOBUFFER_H
+
+#include <QtGlobal>
+#include <QAtomicInt>
+#include <QList>
+#include <QVector>
+#include <string.h>
+
+// planar samples of all channels in one 64 byte aligned block, channel stride is padded to the alignment
+// copies share the samples, views reference a channel/frame range of a buffer and must not outlive it
+template <class T>
+class QVstAudioBuffer
+{
+	struct Storage
+	{
+		QAtomicInt ref;
+		T * samples;
+	};
+	Storage * s;
+	T * base;
+	int chans;
+	int count;
+	int step;
+	void release()
+	{
+		if (s && !s->ref.deref())
+		{
+			qFreeAligned(s->samples);
+			delete s;
+		}
+	}
+public:
+	enum { Alignment = 64 };
+
+// ctor, samples are zeroed
+	QVstAudioBuffer(): s(0), base(0), chans(0), count(0), step(0)
+	{
+	}
+	QVstAudioBuffer(int channels, int frames): s(0), base(0), chans(qMax(0, channels)), count(qMax(0, frames)), step(paddedStride(frames))
+	{
+		if (chans > 0 && step > 0)
+		{
+			s = new Storage();
+			s->ref.store(1);
+			s->samples = (T *)qMallocAligned(chans * step * sizeof(T), Alignment);
+			memset(s->samples, 0, chans * step * sizeof(T));
+			base = s->samples;
+		}
+	}
+	QVstAudioBuffer(const QVstAudioBuffer & o): s(o.s), base(o.base), chans(o.chans), count(o.count), step(o.step)
+	{
+		if (s)
+		{
+			s->ref.ref();
+		}
+	}
+	QVstAudioBuffer & operator = (const QVstAudioBuffer & o)
+	{
+		if (o.s)
+		{
+			o.s->ref.ref();
+		}
+		release();
+		s = o.s;
+		base = o.base;
+		chans = o.chans;
+		count = o.count;
+		step = o.step;
+		return * this;
+	}
+// dtor
+	~QVstAudioBuffer()
+	{
+		release();
+	}
+
+// geometry
+	int channels() const
+	{
+		return chans;
+	}
+	int frames() const
+	{
+		return count;
+	}
+	int stride() const // samples between channel starts
+	{
+		return step;
+	}
+	bool isEmpty() const
+	{
+		return (chans == 0 || count == 0);
+	}
+	bool isView() const
+	{
+		return (base != 0 && s == 0);
+	}
+	static int paddedStride(int frames)
+	{
+		const int n = (int)(Alignment / sizeof(T));
+		return (qMax(0, frames) + n - 1) / n * n;
+	}
+
+// samples
+	T * channel(int i)
+	{
+		return base + i * step;
+	}
+	const T * channel(int i) const
+	{
+		return base + i * step;
+	}
+	T * operator [] (int i)
+	{
+		return channel(i);
+	}
+	const T * operator [] (int i) const
+	{
+		return channel(i);
+	}
+	void fill(T value)
+	{
+		for (int i = 0; i < chans; i++)
+		{
+			T * p = channel(i);
+			for (int k = 0; k < count; k++)
+			{
+				p[k] = value;
+			}
+		}
+	}
+
+// views, not owning
+	QVstAudioBuffer view(int channel, int channels = -1, int frame = 0, int frames = -1) const
+	{
+		QVstAudioBuffer v;
+		channel = qBound(0, channel, chans);
+		frame = qBound(0, frame, count);
+		v.chans = (channels < 0) ? chans - channel : qMin(channels, chans - channel);
+		v.count = (frames < 0) ? count - frame : qMin(frames, count - frame);
+		v.step = step;
+		v.base = base + channel * step + frame;
+		return v;
+	}
+	QVstAudioBuffer mid(int frame, int frames = -1) const
+	{
+		return view(0, -1, frame, frames);
+	}
+
+// conversion
+	QVstAudioBuffer copy() const
+	{
+		QVstAudioBuffer c(chans, count);
+		for (int i = 0; i < chans; i++)
+		{
+			memcpy(c.channel(i), channel(i), count * sizeof(T));
+		}
+		return c;
+	}
+	static QVstAudioBuffer fromList(const QList< QVector<T> > & list)
+	{
+		int frames = list.isEmpty() ? 0 : list.front().count();
+		for (int i = 1; i < list.count(); i++)
+		{
+			frames = qMin(frames, list[i].count());
+		}
+		QVstAudioBuffer b(list.count(), frames);
+		for (int i = 0; i < list.count(); i++)
+		{
+			memcpy(b.channel(i), list[i].constData(), frames * sizeof(T));
+		}
+		return b;
+	}
+	QList< QVector<T> > toList() const
+	{
+		QList< QVector<T> > list;
+		for (int i = 0; i < chans; i++)
+		{
+			QVector<T> v(count);
+			memcpy(v.data(), channel(i), count * sizeof(T));
+			list << v;
+		}
+		return list;
+	}
+};
+
+#endif // QVSTAUDIOBUFFER_H
@@ -0,0 +1,432 @@
+#include "qvstaudit.h"
+#include <QAtomicInt>
+#include <QAtomicPointer>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef QVSTHOST_AUDIT
+#if defined(_MSC_VER)
+#include <Windows.h>
+#include <crtdbg.h>
+#define QVSTAUDIT_THREAD_LOCAL __declspec(thread)
+#define QVSTAUDIT_TLS_MODEL
+#else
+#define QVSTAUDIT_THREAD_LOCAL __thread
+#define QVSTAUDIT_TLS_MODEL __attribute__((tls_model("initial-exec"))) // no allocation at the first access from a heap hook
+#endif
+#if defined(__GLIBC__)
+#include <pthread.h>
+#include <execinfo.h>
+#include <dlfcn.h>
+#include <stdarg.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#if defined(__linux__)
+#include <linux/futex.h>
+#endif
+#endif
+#include <new>
+
+enum AuditKind
+{
+	AuditAllocation,
+	AuditDeallocation,
+	AuditLock
+};
+
+enum
+{
+	MaxStages = 64, // the last one takes the stages beyond
+	MaxDepth = 16
+};
+
+struct AuditStage
+{
+	QAtomicInt claimed;
+	QAtomicPointer<const char> name; // set after index
+	int index;
+	QAtomicInteger<qint64> counts[3]; // AuditKind
+};
+
+// plain data, __thread can't construct
+struct AuditThread
+{
+	int depth;
+	int busy; // reporting, the hooks are off
+	int stage[MaxDepth]; // -1 - entered while disabled
+	int index[MaxDepth]; // chain stage
+	bool plugin[MaxDepth];
+};
+
+static AuditStage audit_stages[MaxStages];
+static QAtomicInt audit_enabled;
+static QAtomicInt audit_plugins;
+static QAtomicInt audit_abort;
+static QAtomicInteger<qint64> audit_violations;
+static QVSTAUDIT_THREAD_LOCAL AuditThread audit_thread QVSTAUDIT_TLS_MODEL;
+
+static int stageIndex(const char * name, int index)
+{
+	for (int i = 0; i < MaxStages; i++)
+	{
+		AuditStage & s = audit_stages[i];
+		const char * n = s.name.loadAcquire();
+		if (!n)
+		{
+			if (s.claimed.testAndSetOrdered(0, 1))
+			{
+				s.index = index;
+				s.name.storeRelease(name);
+				return i;
+			}
+			while (!(n = s.name.loadAcquire()))
+			{
+			}
+		}
+		if (s.index == index && (n == name || strcmp(n, name) == 0))
+		{
+			return i;
+		}
+	}
+	return MaxStages - 1;
+}
+
+static void backtrace()
+{
+#if defined(__GLIBC__)
+	void * frames[64];
+	const int n = ::backtrace(frames, 64);
+	backtrace_symbols_fd(frames, n, 2);
+#elif defined(_MSC_VER)
+	void * frames[64];
+	const int n = CaptureStackBackTrace(1, 64, frames, NULL);
+	for (int i = 0; i < n; i++)
+	{
+		fprintf(stderr, "  %p\n", frames[i]);
+	}
+#endif
+}
+
+static void violation(AuditKind kind)
+{
+	AuditThread & t = audit_thread;
+	if (t.depth == 0 || t.busy || !audit_enabled.load())
+	{
+		return;
+	}
+	const int top = qMin(t.depth, (int)MaxDepth) - 1;
+	if (t.stage[top] < 0 || (t.plugin[top] && !audit_plugins.load()))
+	{
+		return;
+	}
+	AuditStage & s = audit_stages[t.stage[top]];
+	s.counts[kind].fetchAndAddRelaxed(1);
+	audit_violations.fetchAndAddRelaxed(1);
+	if (audit_abort.load())
+	{
+		static const char * const kinds[] = { "allocation", "deallocation", "lock" };
+		t.busy = 1;
+		fprintf(stderr, "QVstAudit: %s in %s (stage %d)\n", kinds[kind], s.name.load(), s.index);
+		backtrace();
+		abort();
+	}
+}
+
+// heap and lock hooks
+#if defined(__GLIBC__)
+extern "C" {
+void * __libc_malloc(size_t);
+void * __libc_calloc(size_t, size_t);
+void * __libc_realloc(void *, size_t);
+void * __libc_memalign(size_t, size_t);
+void __libc_free(void *);
+}
+
+typedef int (* MutexLock)(pthread_mutex_t *);
+static MutexLock audit_mutex_lock = 0; // resolved at the first lock, static init order doesn't matter
+typedef long (* Syscall)(long, ...);
+static Syscall audit_syscall = 0;
+
+extern "C" {
+
+void * malloc(size_t size) throw()
+{
+	violation(AuditAllocation);
+	return __libc_malloc(size);
+}
+
+void * calloc(size_t count, size_t size) throw()
+{
+	violation(AuditAllocation);
+	return __libc_calloc(count, size);
+}
+
+void * realloc(void * p, size_t size) throw()
+{
+	violation(AuditAllocation);
+	return __libc_realloc(p, size);
+}
+
+void * memalign(size_t alignment, size_t size) throw()
+{
+	violation(AuditAllocation);
+	return __libc_memalign(alignment, size);
+}
+
+void free(void * p) throw()
+{
+	if (p)
+	{
+		violation(AuditDeallocation);
+	}
+	__libc_free(p);
+}
+
+int pthread_mutex_lock(pthread_mutex_t * m) throw()
+{
+	violation(AuditLock);
+	if (!audit_mutex_lock)
+	{
+		audit_mutex_lock = (MutexLock)dlsym(RTLD_NEXT, "pthread_mutex_lock");
+	}
+	return audit_mutex_lock(m);
+}
+
+// Qt's locks call the futex syscall when they have to wait
+long syscall(long number, ...) throw()
+{
+	va_list args;
+	va_start(args, number);
+	long a[6];
+	for (int i = 0; i < 6; i++)
+	{
+		a[i] = va_arg(args, long);
+	}
+	va_end(args);
+#if defined(__linux__)
+	if (number == SYS_futex)
+	{
+		const int op = (int)a[1] & FUTEX_CMD_MASK;
+		if (op == FUTEX_WAIT || op == FUTEX_WAIT_BITSET || op == FUTEX_LOCK_PI || op == FUTEX_WAIT_REQUEUE_PI)
+		{
+			violation(AuditLock);
+		}
+	}
+#endif
+	if (!audit_syscall)
+	{
+		audit_syscall = (Syscall)dlsym(RTLD_NEXT, "syscall");
+	}
+	return audit_syscall(number, a[0], a[1], a[2], a[3], a[4], a[5]);
+}
+}
+#elif defined(_MSC_VER) && defined(_DEBUG)
+static int __cdecl allocHook(int type, void *, size_t, int block, long, const unsigned char *, int)
+{
+	if (block != _CRT_BLOCK)
+	{
+		violation(type == _HOOK_FREE ? AuditDeallocation : AuditAllocation);
+	}
+	return TRUE;
+}
+
+static const bool audit_hooked = (_CrtSetAllocHook(allocHook), true);
+#else
+void * operator new(size_t size)
+{
+	violation(AuditAllocation);
+	void * p = malloc(size ? size : 1);
+	if (!p)
+	{
+		throw std::bad_alloc();
+	}
+	return p;
+}
+
+void * operator new[](size_t size)
+{
+	return operator new(size);
+}
+
+void * operator new(size_t size, const std::nothrow_t &) throw()
+{
+	violation(AuditAllocation);
+	return malloc(size ? size : 1);
+}
+
+void * operator new[](size_t size, const std::nothrow_t &) throw()
+{
+	return operator new(size, std::nothrow);
+}
+
+void operator delete(void * p) throw()
+{
+	if (p)
+	{
+		violation(AuditDeallocation);
+	}
+	free(p);
+}
+
+void operator delete[](void * p) throw()
+{
+	operator delete(p);
+}
+
+void operator delete(void * p, const std::nothrow_t &) throw()
+{
+	operator delete(p);
+}
+
+void operator delete[](void * p, const std::nothrow_t &) throw()
+{
+	operator delete(p);
+}
+#endif
+#endif // QVSTHOST_AUDIT
+
+bool QVstAudit::isAvailable()
+{
+#ifdef QVSTHOST_AUDIT
+	return true;
+#else
+	return false;
+#endif
+}
+
+void QVstAudit::setEnabled(bool state)
+{
+#ifdef QVSTHOST_AUDIT
+	audit_enabled.store(state ? 1 : 0);
+#else
+	Q_UNUSED(state);
+#endif
+}
+
+bool QVstAudit::isEnabled()
+{
+#ifdef QVSTHOST_AUDIT
+	return audit_enabled.load() != 0;
+#else
+	return false;
+#endif
+}
+
+void QVstAudit::setPluginsAudited(bool state)
+{
+#ifdef QVSTHOST_AUDIT
+	audit_plugins.store(state ? 1 : 0);
+#else
+	Q_UNUSED(state);
+#endif
+}
+
+bool QVstAudit::pluginsAudited()
+{
+#ifdef QVSTHOST_AUDIT
+	return audit_plugins.load() != 0;
+#else
+	return false;
+#endif
+}
+
+void QVstAudit::setAbortOnViolation(bool state)
+{
+#ifdef QVSTHOST_AUDIT
+	audit_abort.store(state ? 1 : 0);
+#else
+	Q_UNUSED(state);
+#endif
+}
+
+bool QVstAudit::abortOnViolation()
+{
+#ifdef QVSTHOST_AUDIT
+	return audit_abort.load() != 0;
+#else
+	return false;
+#endif
+}
+
+QList<QVstAudit::Counts> QVstAudit::counts()
+{
+	QList<Counts> l;
+#ifdef QVSTHOST_AUDIT
+	for (int i = 0; i < MaxStages; i++)
+	{
+		const char * name = audit_stages[i].name.loadAcquire();
+		if (!name)
+		{
+			break;
+		}
+		Counts c;
+		c.stage = name;
+		c.index = audit_stages[i].index;
+		c.allocations = audit_stages[i].counts[AuditAllocation].load();
+		c.deallocations = audit_stages[i].counts[AuditDeallocation].load();
+		c.locks = audit_stages[i].counts[AuditLock].load();
+		l << c;
+	}
+#endif
+	return l;
+}
+
+qint64 QVstAudit::violationsCount()
+{
+#ifdef QVSTHOST_AUDIT
+	return audit_violations.load();
+#else
+	return 0;
+#endif
+}
+
+void QVstAudit::reset()
+{
+#ifdef QVSTHOST_AUDIT
+	for (int i = 0; i < MaxStages; i++)
+	{
+		for (int k = 0; k < 3; k++)
+		{
+			audit_stages[i].counts[k].store(0);
+		}
+	}
+	audit_violations.store(0);
+#endif
+}
+
+void QVstAudit::enter(const char * stage, bool plugin, int index)
+{
+#ifdef QVSTHOST_AUDIT
+	AuditThread & t = audit_thread;
+	if (t.depth < MaxDepth)
+	{
+		if (index < 0 && t.depth > 0)
+		{
+			index = t.index[t.depth - 1];
+		}
+		t.stage[t.depth] = audit_enabled.load() ? stageIndex(stage, index) : -1;
+		t.index[t.depth] = index;
+		t.plugin[t.depth] = plugin;
+	}
+	t.depth++;
+#else
+	Q_UNUSED(stage);
+	Q_UNUSED(plugin);
+	Q_UNUSED(index);
+#endif
+}
+
+void QVstAudit::leave()
+{
+#ifdef QVSTHOST_AUDIT
+	audit_thread.depth--;
+#endif
+}
+
+void QVstAudit::lock()
+{
+#ifdef QVSTHOST_AUDIT
+	violation(AuditLock);
+#endif
+}
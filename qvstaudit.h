@@ -0,0 +1,66 @@
+#ifndef QVSTAUDIT_H
+#define QVSTAUDIT_H
+
+#include <QtGlobal>
+#include <QList>
+
+// realtime safety audit of the process path, built in with QVSTHOST_AUDIT defined only (a no-op otherwise):
+// the host marks the calling thread while it's inside process, heap calls made there are counted per stage
+// and chain stage index, so are locks: pthread_mutex_lock and blocking futex waits on glibc (where Qt's
+// mutexes, semaphores and wait conditions block, their uncontended fast paths make no call) and the host's own
+// lock() probes,
+// heap calls are malloc family on glibc, the debug CRT heap on MSVC, operator new/delete elsewhere
+class QVstAudit
+{
+public:
+	struct Counts
+	{
+		const char * stage;
+		int index; // chain stage, -1 - outside a chain
+		qint64 allocations;
+		qint64 deallocations;
+		qint64 locks;
+	};
+
+// control
+	static bool isAvailable(); // built with QVSTHOST_AUDIT
+	static void setEnabled(bool);
+	static bool isEnabled();
+	static void setPluginsAudited(bool); // calls made inside the plugins' process count too, off by default
+	static bool pluginsAudited();
+	static void setAbortOnViolation(bool); // prints the stage and a backtrace to stderr, then aborts
+	static bool abortOnViolation();
+
+// results
+	static QList<Counts> counts(); // stages seen so far, in the order they were first entered
+	static qint64 violationsCount();
+	static void reset();
+
+// marking, stage names must be static strings
+	static void enter(const char * stage, bool plugin = false, int index = -1); // plugin - the code running is the plugin's, index -1 - the enclosing one's
+	static void leave();
+	static void lock(); // probe for host locks that aren't pthread mutexes
+
+	class Scope
+	{
+	public:
+		explicit Scope(const char * stage, bool plugin = false, int index = -1)
+		{
+#ifdef QVSTHOST_AUDIT
+			enter(stage, plugin, index);
+#else
+			Q_UNUSED(stage);
+			Q_UNUSED(plugin);
+			Q_UNUSED(index);
+#endif
+		}
+		~Scope()
+		{
+#ifdef QVSTHOST_AUDIT
+			leave();
+#endif
+		}
+	};
+};
+
+#endif // QVSTAUDIT_H
@@ -0,0 +1,260 @@
+#include "qvstbatch.h"
+#include <QThreadPool>
+#include <QRunnable>
+#include <QThread>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QElapsedTimer>
+#include <QAtomicInt>
+#include <QFileInfo>
+#include <QDir>
+#include <QMap>
+
+struct BatchWorker;
+
+// absolute path, case folded where file systems usually ignore case
+static QString pathKey(const QString & path)
+{
+	const QString key = QDir::cleanPath(QFileInfo(path).absoluteFilePath());
+#if defined(Q_OS_WIN) || defined(Q_OS_MAC)
+	return key.toLower();
+#else
+	return key;
+#endif
+}
+
+// parameters of every plugin, taken once after the preset is loaded
+struct BatchSnapshot
+{
+	QList< QList<float> > parameters;
+	void take(const QVstChain & chain)
+	{
+		parameters.clear();
+		foreach (const QVstPlugin & vst, chain)
+		{
+			QList<float> l;
+			for (int i = 0; i < vst.parametersCount(); i++)
+			{
+				l << vst.parameter(i);
+			}
+			parameters << l;
+		}
+	}
+	void restore(QVstChain & chain) const
+	{
+		for (int k = 0; k < qMin(chain.count(), parameters.count()); k++)
+		{
+			chain[k].setParameters(parameters[k]);
+		}
+	}
+};
+
+// takes jobs until the queue is empty
+class BatchTask: public QRunnable
+{
+	BatchWorker * worker;
+public:
+	BatchTask(BatchWorker * w): worker(w)
+	{
+		setAutoDelete(false);
+	}
+	void run();
+};
+
+struct BatchRun
+{
+	const QList<QVstBatchRenderer::Job> * jobs;
+	const BatchSnapshot * snapshot;
+	QAtomicInt next; // queue head
+	QMutex lock; // report
+	QVstBatchRenderer::Report report;
+};
+
+struct BatchWorker
+{
+	QVstChain chain;
+	QVstRenderer renderer;
+	BatchTask task;
+	BatchRun * batch;
+	BatchWorker(const QVstChain & c): chain(c), renderer(chain), task(this), batch(0)
+	{
+	}
+	void run()
+	{
+		for (int i = batch->next.fetchAndAddRelaxed(1); i < batch->jobs->count(); i = batch->next.fetchAndAddRelaxed(1))
+		{
+			const QVstBatchRenderer::Job & job = batch->jobs->at(i);
+			batch->snapshot->restore(chain);
+			const bool ok = renderer.render(job.input, job.output);
+			QMutexLocker locker(& batch->lock);
+			QVstBatchRenderer::Report & r = batch->report;
+			if (!ok)
+			{
+				r.failed++;
+				r.errors << job.input + ": " + renderer.errorString();
+				continue;
+			}
+			r.files++;
+			r.frames += renderer.framesRead();
+			if (renderer.sampleRate() > 0)
+			{
+				r.audioSeconds += (double)renderer.framesRead() / renderer.sampleRate();
+			}
+		}
+	}
+};
+
+void BatchTask::run()
+{
+	worker->run();
+}
+
+QVstBatchRenderer::Report::Report(): files(0), failed(0), frames(0), seconds(0.0), audioSeconds(0.0), realtime(0.0)
+{
+}
+
+struct QVstBatchRenderer::Data
+{
+	QList<BatchWorker *> workers;
+	BatchSnapshot snapshot;
+	QThreadPool pool;
+	bool valid;
+	Data(): valid(false)
+	{
+	}
+	~Data()
+	{
+		pool.waitForDone();
+		qDeleteAll(workers);
+	}
+};
+
+QVstBatchRenderer::QVstBatchRenderer(const QString & preset, int workers): d(new Data())
+{
+	QVstChain chain;
+	d->valid = chain.loadPreset(preset) && !chain.isEmpty();
+	if (!d->valid)
+	{
+		return;
+	}
+	d->snapshot.take(chain);
+	const int count = (workers > 0) ? workers : qMax(1, QThread::idealThreadCount());
+	d->workers << new BatchWorker(chain);
+	for (int k = 1; k < count; k++)
+	{
+		d->workers << new BatchWorker(chain.clone());
+	}
+	d->pool.setMaxThreadCount(count);
+	d->pool.setExpiryTimeout(-1);
+}
+
+QVstBatchRenderer::~QVstBatchRenderer()
+{
+	delete d;
+}
+
+bool QVstBatchRenderer::isValid() const
+{
+	return d->valid;
+}
+
+int QVstBatchRenderer::workersCount() const
+{
+	return d->workers.count();
+}
+
+void QVstBatchRenderer::setBlockSize(int frames)
+{
+	foreach (BatchWorker * w, d->workers)
+	{
+		w->renderer.setBlockSize(frames);
+	}
+}
+
+void QVstBatchRenderer::setOutputFormat(QVstRenderer::SampleFormat format)
+{
+	foreach (BatchWorker * w, d->workers)
+	{
+		w->renderer.setOutputFormat(format);
+	}
+}
+
+void QVstBatchRenderer::setDither(bool state)
+{
+	foreach (BatchWorker * w, d->workers)
+	{
+		w->renderer.setDither(state);
+	}
+}
+
+void QVstBatchRenderer::setDefaultTail(int frames)
+{
+	foreach (BatchWorker * w, d->workers)
+	{
+		w->renderer.setDefaultTail(frames);
+	}
+}
+
+QVstBatchRenderer::Report QVstBatchRenderer::render(const QList<Job> & jobs)
+{
+	BatchRun batch;
+	QMap<QString, int> inputs;
+	foreach (const Job & job, jobs)
+	{
+		inputs[pathKey(job.input)] = 1;
+	}
+	QMap<QString, int> outputs;
+	QList<Job> accepted;
+	foreach (const Job & job, jobs)
+	{
+		const QString key = pathKey(job.output);
+		if (inputs.contains(key) || outputs.contains(key))
+		{
+			batch.report.failed++;
+			batch.report.errors << job.input + ": " + job.output + " is another job's input or output";
+			continue;
+		}
+		outputs[key] = 1;
+		accepted << job;
+	}
+	batch.jobs = & accepted;
+	batch.snapshot = & d->snapshot;
+	QElapsedTimer timer;
+	timer.start();
+	foreach (BatchWorker * w, d->workers)
+	{
+		w->batch = & batch;
+		d->pool.start(& w->task);
+	}
+	d->pool.waitForDone();
+	Report & r = batch.report;
+	r.seconds = timer.nsecsElapsed() / 1e9;
+	r.realtime = (r.seconds > 0.0) ? r.audioSeconds / r.seconds : 0.0;
+	return r;
+}
+
+QList<QVstBatchRenderer::Job> QVstBatchRenderer::jobs(const QStringList & inputs, const QString & output_dir)
+{
+	QList<Job> l;
+	const QDir dir(output_dir);
+	QMap<QString, int> used;
+	foreach (const QString & input, inputs)
+	{
+		used[pathKey(input)] = 1;
+	}
+	foreach (const QString & input, inputs)
+	{
+		const QFileInfo info(input);
+		const QString suffix = info.suffix().isEmpty() ? QString() : "." + info.suffix();
+		Job job;
+		job.input = input;
+		job.output = dir.filePath(info.fileName());
+		for (int n = 2; used.contains(pathKey(job.output)); n++)
+		{
+			job.output = dir.filePath(info.completeBaseName() + "_" + QString::number(n) + suffix);
+		}
+		used[pathKey(job.output)] = 1;
+		l << job;
+	}
+	return l;
+}
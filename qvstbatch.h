@@ -0,0 +1,53 @@
+#ifndef QVSTBATCH_H
+#define QVSTBATCH_H
+
+#include "qvstrender.h"
+#include <QStringList>
+
+// renders many files through one chain preset in parallel: the preset is read once, every worker thread owns
+// a prepared clone of the chain and takes files from a shared queue, each file starts from the preset's
+// parameters restored from memory
+class QVstBatchRenderer
+{
+	struct Data;
+	Data * d;
+	QVstBatchRenderer(const QVstBatchRenderer &);
+	QVstBatchRenderer & operator = (const QVstBatchRenderer &);
+public:
+	struct Job
+	{
+		QString input;
+		QString output;
+	};
+	struct Report
+	{
+		int files; // rendered
+		int failed;
+		qint64 frames; // input frames rendered
+		double seconds; // wall clock
+		double audioSeconds; // input duration
+		double realtime; // audioSeconds / seconds
+		QStringList errors; // "file: error"
+		Report();
+	};
+
+// ctor
+	explicit QVstBatchRenderer(const QString & preset, int workers = 0); // ini filename, 0 workers - QThread::idealThreadCount()
+// dtor
+	~QVstBatchRenderer();
+
+	bool isValid() const; // the preset loaded
+	int workersCount() const;
+
+// options, applied to every worker's QVstRenderer
+	void setBlockSize(int);
+	void setOutputFormat(QVstRenderer::SampleFormat);
+	void setDither(bool);
+	void setDefaultTail(int);
+
+// rendering
+	Report render(const QList<Job> &); // a job writing another job's input or output is rejected and reported failed
+	static QList<Job> jobs(const QStringList & inputs, const QString & output_dir); // same file names in output_dir, repeated or inputs' names get _2, _3...
+};
+
+#endif // QVSTBATCH_H
@@ -0,0 +1,318 @@
+#include "qvstfanout.h"
+#include <QSemaphore>
+#include <QElapsedTimer>
+#include <QThread>
+#include <string.h>
+#include "qvstaudit.h"
+#include "qvsttrace.h"
+
+struct FanOut;
+
+// persistent thread, every wake processes every groups-th instance starting from group
+class FanOutWorker: public QThread
+{
+	FanOut * fan;
+	int group;
+public:
+	QSemaphore wake;
+	FanOutWorker(FanOut * f, int g): fan(f), group(g)
+	{
+	}
+	void run();
+};
+
+struct FanOut
+{
+	AEffect effect;
+	QList<QVstPlugin> instances;
+	QString name;
+	int inputs; // per instance
+	int outputs;
+	int threshold;
+	QVector<float> params; // first instance values seen by the other instances
+	QList<FanOutWorker *> workers;
+	QSemaphore done;
+	bool quit;
+	qint64 cost; // usecs, all instances of the last block
+	void ** in;
+	void ** out;
+	int count;
+	bool doubles;
+	FanOut(): inputs(0), outputs(0), threshold(-1), quit(false), cost(0), in(0), out(0), count(0), doubles(false)
+	{
+		memset(& effect, 0, sizeof(effect));
+	}
+	~FanOut()
+	{
+		quit = true;
+		foreach (FanOutWorker * w, workers)
+		{
+			w->wake.release();
+		}
+		foreach (FanOutWorker * w, workers)
+		{
+			w->wait();
+		}
+		qDeleteAll(workers);
+	}
+	AEffect * instance(int k)
+	{
+		return (AEffect *)instances[k].lowLevelApi();
+	}
+	VstIntPtr broadcast(VstInt32 opcode, VstInt32 index, VstIntPtr value, void * ptr, float opt)
+	{
+		VstIntPtr r = 0;
+		for (int k = instances.count() - 1; k >= 0; k--)
+		{
+			r = instance(k)->dispatcher(instance(k), opcode, index, value, ptr, opt);
+		}
+		return r;
+	}
+	void setParameter(int index, float value)
+	{
+		for (int k = 0; k < instances.count(); k++)
+		{
+			instance(k)->setParameter(instance(k), index, value);
+		}
+		if (index >= 0 && index < params.count())
+		{
+			params[index] = value;
+		}
+	}
+	void syncParameters()
+	{
+		AEffect * first = instance(0);
+		for (int i = 0; i < params.count(); i++)
+		{
+			const float v = first->getParameter(first, i);
+			if (v != params[i])
+			{
+				for (int k = 1; k < instances.count(); k++)
+				{
+					instance(k)->setParameter(instance(k), i, v);
+				}
+				params[i] = v;
+			}
+		}
+	}
+	void readParameters()
+	{
+		AEffect * first = instance(0);
+		for (int i = 0; i < params.count(); i++)
+		{
+			params[i] = first->getParameter(first, i);
+		}
+	}
+	void process(int k)
+	{
+		AEffect * a = instance(k);
+		QVstAudit::Scope audit("plugin", true);
+		if (doubles)
+		{
+			a->processDoubleReplacing(a, (double **)in + k * inputs, (double **)out + k * outputs, count);
+		}
+		else
+		{
+			a->processReplacing(a, (float **)in + k * inputs, (float **)out + k * outputs, count);
+		}
+	}
+	void processGroup(int group)
+	{
+		for (int k = group; k < instances.count(); k += workers.count() + 1)
+		{
+			process(k);
+		}
+	}
+	void run(void ** inputs_ptr, void ** outputs_ptr, int samples, bool d)
+	{
+		in = inputs_ptr;
+		out = outputs_ptr;
+		count = samples;
+		doubles = d;
+		QVstAudit::Scope audit("QVstFanOut");
+		QElapsedTimer timer;
+		timer.start();
+		if (workers.isEmpty() || threshold < 0 || cost <= threshold)
+		{
+			for (int k = 0; k < instances.count(); k++)
+			{
+				process(k);
+			}
+			cost = timer.nsecsElapsed() / 1000;
+			return;
+		}
+		QVstAudit::lock(); // the semaphores, mutex based where Qt has no futex
+		for (int t = 0; t < workers.count(); t++)
+		{
+			workers[t]->wake.release();
+		}
+		processGroup(0);
+		cost = timer.nsecsElapsed() / 1000 * (workers.count() + 1);
+		done.acquire(workers.count());
+	}
+};
+
+void FanOutWorker::run()
+{
+	QVstTrace::registerThread();
+	for (;;)
+	{
+		wake.acquire();
+		if (fan->quit)
+		{
+			return;
+		}
+		fan->processGroup(group);
+		fan->done.release();
+	}
+}
+
+static AEffect * createEffect(const QString & name, int instances, const QString & preset, int parallel_threshold);
+
+// AEffect callbacks
+extern "C" {
+static VstIntPtr VSTCALLBACK fanDispatcher(AEffect * effect, VstInt32 opcode, VstInt32 index, VstIntPtr value, void * ptr, float opt)
+{
+	FanOut * fan = (FanOut *)effect->object;
+	switch (opcode)
+	{
+	case effOpen:
+		return 0;
+	case effClose:
+		delete fan;
+		return 1;
+	case effSetProgram:
+	case effSetProgramName:
+	case effSetSampleRate:
+	case effSetBlockSize:
+	case effMainsChanged:
+	case effStartProcess:
+	case effStopProcess:
+	case effSetProcessPrecision:
+	case effSetBypass:
+	case effBeginSetProgram:
+	case effEndSetProgram:
+	case effSetChunk:
+	{
+		const VstIntPtr r = fan->broadcast(opcode, index, value, ptr, opt);
+		if (opcode == effSetProgram || opcode == effSetChunk)
+		{
+			fan->readParameters();
+		}
+		return r;
+	}
+	case effEditIdle:
+	case effEditClose:
+	{
+		const VstIntPtr r = fan->instance(0)->dispatcher(fan->instance(0), opcode, index, value, ptr, opt);
+		fan->syncParameters();
+		return r;
+	}
+	case effGetInputProperties:
+		if (index < 0 || index >= fan->inputs * fan->instances.count())
+		{
+			return 0;
+		}
+		return fan->instance(index / fan->inputs)->dispatcher(fan->instance(index / fan->inputs), opcode, index % fan->inputs, value, ptr, opt);
+	case effGetOutputProperties:
+		if (index < 0 || index >= fan->outputs * fan->instances.count())
+		{
+			return 0;
+		}
+		return fan->instance(index / fan->outputs)->dispatcher(fan->instance(index / fan->outputs), opcode, index % fan->outputs, value, ptr, opt);
+	case effSetSpeakerArrangement:
+	case effGetSpeakerArrangement:
+		return 0;
+	case effVendorSpecific:
+		if (index == QVstPlugin::CloneEffect)
+		{
+			return (VstIntPtr)createEffect(fan->name, fan->instances.count(), QString(), fan->threshold);
+		}
+		break;
+	}
+	return fan->instance(0)->dispatcher(fan->instance(0), opcode, index, value, ptr, opt);
+}
+
+static void VSTCALLBACK fanSetParameter(AEffect * effect, VstInt32 index, float value)
+{
+	((FanOut *)effect->object)->setParameter(index, value);
+}
+
+static float VSTCALLBACK fanGetParameter(AEffect * effect, VstInt32 index)
+{
+	FanOut * fan = (FanOut *)effect->object;
+	return fan->instance(0)->getParameter(fan->instance(0), index);
+}
+
+static void VSTCALLBACK fanProcessReplacing(AEffect * effect, float ** inputs, float ** outputs, VstInt32 samples)
+{
+	((FanOut *)effect->object)->run((void **)inputs, (void **)outputs, samples, false);
+}
+
+static void VSTCALLBACK fanProcessDoubleReplacing(AEffect * effect, double ** inputs, double ** outputs, VstInt32 samples)
+{
+	((FanOut *)effect->object)->run((void **)inputs, (void **)outputs, samples, true);
+}
+}
+
+static AEffect * createEffect(const QString & name, int instances, const QString & preset, int parallel_threshold)
+{
+	QVstPlugin first(name, preset);
+	if (!first.isLoaded() || instances < 1)
+	{
+		return 0;
+	}
+	FanOut * fan = new FanOut();
+	fan->name = name;
+	fan->threshold = parallel_threshold;
+	fan->instances << first;
+	for (int k = 1; k < instances; k++)
+	{
+		QVstPlugin vst = first.clone();
+		if (!vst.isLoaded())
+		{
+			delete fan;
+			return 0;
+		}
+		fan->instances << vst;
+	}
+	fan->inputs = first.inputsCount();
+	fan->outputs = first.outputsCount();
+	fan->params = QVector<float>(first.parametersCount());
+	fan->readParameters();
+	const int groups = (parallel_threshold < 0) ? 1 : qMin(instances, QThread::idealThreadCount());
+	for (int t = 1; t < groups; t++)
+	{
+		fan->workers << new FanOutWorker(fan, t);
+		fan->workers.back()->start(QThread::TimeCriticalPriority);
+	}
+
+	const AEffect * a = first.lowLevelApi();
+	AEffect & e = fan->effect;
+	e.magic = kEffectMagic;
+	e.dispatcher = fanDispatcher;
+	e.setParameter = fanSetParameter;
+	e.getParameter = fanGetParameter;
+	e.processReplacing = fanProcessReplacing;
+	e.processDoubleReplacing = fanProcessDoubleReplacing;
+	e.numPrograms = a->numPrograms;
+	e.numParams = a->numParams;
+	e.numInputs = a->numInputs * instances;
+	e.numOutputs = a->numOutputs * instances;
+	e.flags = a->flags;
+	e.initialDelay = a->initialDelay;
+	e.uniqueID = a->uniqueID;
+	e.version = a->version;
+	e.object = fan;
+	return & e;
+}
+
+QVstPlugin QVstFanOut::create(const QString & name, int instances, const QString & preset, int parallel_threshold)
+{
+	AEffect * e = createEffect(name, instances, preset, parallel_threshold);
+	if (!e)
+	{
+		return QVstPlugin();
+	}
+	return QVstPlugin(e);
+}
@@ -0,0 +1,16 @@
+#ifndef QVSTFANOUT_H
+#define QVSTFANOUT_H
+
+#include "qvsthost.h"
+
+// N instances of one plugin presented as a single plugin with N times its pins,
+// instance k takes pins [k * inputs, (k + 1) * inputs), parameters, programs and chunks are linked,
+// the editor is the first instance's one and its changes are copied to the others on idle,
+// a fan-out has no file to load it from, so a chain holding one can't be saved with QVstChain::savePreset()
+class QVstFanOut
+{
+public:
+	static QVstPlugin create(const QString & name, int instances, const QString & preset = QString(), int parallel_threshold = 200); // usecs of block cost above which instances run on worker threads started with the effect, -1 - never, no threads
+};
+
+#endif // QVSTFANOUT_H
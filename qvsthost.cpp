@@ -1,7 +1,24 @@
 #include "qvsthost.h"
 #include <QLibrary>
 #include <QDebug>
-#include <Windows.h>
+#include <QAtomicInt>
+#include <QAtomicPointer>
+#include <QVarLengthArray>
+#include <QElapsedTimer>
+#include <string.h>
+#include "qvstsimd.h"
+#include "qvsttrace.h"
+#include "qvstaudit.h"
+
+// host side state reachable from AEffect::user
+struct QVstHostContext
+{
+	int initialdelay;
+	bool iochanged;
+	QVstHostContext(): initialdelay(0), iochanged(false)
+	{
+	}
+};
 
 // C callbacks
 extern "C" {
@@ -9,6 +26,7 @@ extern "C" {
 VstIntPtr VSTCALLBACK hostCallback(AEffect *effect, VstInt32 opcode, VstInt32 /*index*/, VstIntPtr /*value*/, void *ptr, float /*opt*/)
 {
 	static const char product_string[] = "QVstHost";
+	QVstTrace::Scope trace("host", QVstTrace::hostOpcodeName(opcode), effect ? effect->uniqueID : 0);
 	switch(opcode) 
 	{
 	case audioMasterVersion:
@@ -24,6 +42,10 @@ VstIntPtr VSTCALLBACK hostCallback(AEffect *effect, VstInt32 opcode, VstInt32 /*
 	case audioMasterGetVendorVersion:
 		return 1;
 	case audioMasterCanDo:
+		if (qstrcmp((char *)ptr, "acceptIOChanges") == 0)
+		{
+			return 1;
+		}
 		qDebug() << (char *)ptr;
 		return 0;
 	case audioMasterGetCurrentProcessLevel:
@@ -32,6 +54,13 @@ VstIntPtr VSTCALLBACK hostCallback(AEffect *effect, VstInt32 opcode, VstInt32 /*
 		return 0;
 	case audioMasterAutomate:
 		return 0;
+	case audioMasterIOChanged:
+		if (effect && effect->user)
+		{
+			static_cast<QVstHostContext *>(effect->user)->initialdelay = effect->initialDelay;
+			static_cast<QVstHostContext *>(effect->user)->iochanged = true;
+		}
+		return 1;
 	case 4 /*audioMasterPinConnected*/:
 	case 6 /*audioMasterWantMidi*/:
 	case 14 /*audioMasterNeedIdle*/:
@@ -42,777 +71,2553 @@ VstIntPtr VSTCALLBACK hostCallback(AEffect *effect, VstInt32 opcode, VstInt32 /*
 }
 }
 
-// plugin's entry point
-typedef AEffect *(VSTCALLBACK *vstFuncPtr)(audioMasterCallback host);
-
-struct QVstPlugin::Data
+// sample kernels
+template <class T>
+static bool isSilent(const T * const * in, int channels, int count)
+{
+	for (int i = 0; i < channels; i++)
+	{
+		if (!QVstSimd::isSilent(in[i], count))
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+// preallocated ring buffer delay, input and output must not overlap
+template <class T>
+class DelayLine
+{
+	QVector<T> ring;
+	int pos;
+public:
+	DelayLine(): pos(0)
+	{
+	}
+	int delay() const
+	{
+		return ring.count();
+	}
+	void setDelay(int samples)
+	{
+		if (samples != ring.count())
+		{
+			ring = QVector<T>(samples, 0);
+			pos = 0;
+		}
+	}
+	void process(const T * in, T * out, int count)
+	{
+		if (ring.isEmpty())
+		{
+			memcpy(out, in, count * sizeof(T));
+			return;
+		}
+		T * r = ring.data();
+		for (int done = 0; done < count; )
+		{
+			const int n = qMin(count - done, ring.count() - pos);
+			memcpy(out + done, r + pos, n * sizeof(T));
+			memcpy(r + pos, in + done, n * sizeof(T));
+			pos = (pos + n) % ring.count();
+			done += n;
+		}
+	}
+	void clear()
+	{
+		if (!ring.isEmpty())
+		{
+			memset(ring.data(), 0, ring.count() * sizeof(T));
+		}
+		pos = 0;
+	}
+	void write(const T * in, int count)
+	{
+		if (ring.isEmpty())
+		{
+			return;
+		}
+		T * r = ring.data();
+		for (int done = 0; done < count; )
+		{
+			const int n = qMin(count - done, ring.count() - pos);
+			memcpy(r + pos, in + done, n * sizeof(T));
+			pos = (pos + n) % ring.count();
+			done += n;
+		}
+	}
+};
+
+// lock free single producer single consumer ring, push() fails when full
+template <class T, int N>
+class EventQueue
+{
+	T items[N];
+	QAtomicInt head; // next to pop, owned by the consumer
+	QAtomicInt tail; // next to push, owned by the producer
+public:
+	EventQueue(): head(0), tail(0)
+	{
+	}
+	bool push(const T & v)
+	{
+		const int t = tail.load();
+		const int next = (t + 1) % N;
+		if (next == head.loadAcquire())
+		{
+			return false;
+		}
+		items[t] = v;
+		tail.storeRelease(next);
+		return true;
+	}
+	bool pop(T & v)
+	{
+		const int h = head.load();
+		if (h == tail.loadAcquire())
+		{
+			return false;
+		}
+		v = items[h];
+		head.storeRelease((h + 1) % N);
+		return true;
+	}
+};
+
+// planar scratch behind the interleaved entry points, and behind process() calls of the other precision
+template <class T>
+struct PlanarScratch
+{
+	QVstAudioBuffer<T> in;
+	QVstAudioBuffer<T> out;
+	QVector<T *> inptr;
+	QVector<T *> outptr;
+	int block;
+	PlanarScratch(): block(0)
+	{
+	}
+	void allocate(int inputs, int outputs, int frames)
+	{
+		block = frames;
+		in = QVstAudioBuffer<T>(inputs, frames);
+		out = QVstAudioBuffer<T>(outputs, frames);
+		inptr = QVector<T *>(inputs);
+		outptr = QVector<T *>(outputs);
+		for (int k = 0; k < inputs; k++)
+		{
+			inptr[k] = in.channel(k);
+		}
+		for (int k = 0; k < outputs; k++)
+		{
+			outptr[k] = out.channel(k);
+		}
+	}
+	void clear()
+	{
+		for (int k = 0; block > 0 && k < inptr.count(); k++)
+		{
+			memset(inptr[k], 0, block * sizeof(T));
+		}
+		for (int k = 0; block > 0 && k < outptr.count(); k++)
+		{
+			memset(outptr[k], 0, block * sizeof(T));
+		}
+	}
+};
+
+template <class T>
+static bool processInterleaved(QVstPlugin & vst, PlanarScratch<T> & s, const T * in, T * out, int frames)
+{
+	const int inputs = s.inptr.count();
+	const int outputs = s.outptr.count();
+	if (s.block == 0 || inputs != vst.inputsCount() || outputs != vst.outputsCount())
+	{
+		return false;
+	}
+	for (int offset = 0; offset < frames; offset += s.block)
+	{
+		const int n = qMin(s.block, frames - offset);
+		QVstSimd::deinterleave(in + offset * inputs, s.inptr.constData(), inputs, n);
+		if (!vst.process((const T **)s.inptr.data(), s.outptr.data(), n))
+		{
+			return false;
+		}
+		QVstSimd::interleave(s.outptr.constData(), out + offset * outputs, outputs, n);
+	}
+	return true;
+}
+
+template <class T>
+static bool processBuffer(QVstPlugin & vst, const QVstAudioBuffer<T> & in, QVstAudioBuffer<T> & out)
+{
+	const int inputs = vst.inputsCount();
+	const int outputs = vst.outputsCount();
+	if (in.channels() != inputs || out.channels() != outputs || (inputs > 0 && in.frames() < out.frames()))
+	{
+		return false;
+	}
+	QVarLengthArray<const T *, 16> src(inputs);
+	QVarLengthArray<T *, 16> dst(outputs);
+	for (int k = 0; k < inputs; k++)
+	{
+		src[k] = in.channel(k);
+	}
+	for (int k = 0; k < outputs; k++)
+	{
+		dst[k] = out.channel(k);
+	}
+	return vst.process(src.data(), dst.data(), out.frames());
+}
+
+// mono convenience path, unused outputs go to a shared discard block
+template <class T>
+static bool processOne(QVstPlugin & vst, QVector<T> & discard, const QVector<T> & in, QVector<T> & out)
+{
+	const int inputs = vst.inputsCount();
+	const int outputs = vst.outputsCount();
+	const int block = vst.blockSize();
+	if (outputs == 0 || block <= 0)
+	{
+		return false;
+	}
+	const int count = inputs > 0 ? in.count() : block;
+	if (outputs > 1 && discard.count() < block)
+	{
+		discard.resize(block);
+	}
+	out.resize(count);
+	T * o = out.data();
+	QVarLengthArray<const T *, 16> src(inputs);
+	QVarLengthArray<T *, 16> dst(outputs);
+	for (int offset = 0; offset < count; offset += block)
+	{
+		for (int k = 0; k < inputs; k++)
+		{
+			src[k] = in.constData() + offset;
+		}
+		dst[0] = o + offset;
+		for (int k = 1; k < outputs; k++)
+		{
+			dst[k] = discard.data();
+		}
+		if (!vst.process(src.data(), dst.data(), qMin(block, count - offset)))
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+// processReplacing timing, written by the processing thread only, read and reset from any
+struct ProcessCounters
+{
+	enum { Buckets = 32 };
+	QAtomicInteger<qint64> calls;
+	QAtomicInteger<qint64> samples;
+	QAtomicInteger<qint64> total;
+	QAtomicInteger<qint64> min;
+	QAtomicInteger<qint64> max;
+	QAtomicInteger<qint64> histogram[Buckets];
+	QAtomicInt reset; // requested, applied by the next add()
+	ProcessCounters(): reset(1)
+	{
+	}
+	static int bucket(qint64 ns)
+	{
+		int k = 0;
+		while (ns > 1 && k < Buckets - 1)
+		{
+			ns >>= 1;
+			k++;
+		}
+		return k;
+	}
+	void add(qint64 ns, int count)
+	{
+		if (reset.loadAcquire())
+		{
+			calls.store(0);
+			samples.store(0);
+			total.store(0);
+			min.store(ns);
+			max.store(ns);
+			for (int k = 0; k < Buckets; k++)
+			{
+				histogram[k].store(0);
+			}
+			reset.storeRelease(0);
+		}
+		calls.store(calls.load() + 1);
+		samples.store(samples.load() + count);
+		total.store(total.load() + ns);
+		if (ns < min.load())
+		{
+			min.store(ns);
+		}
+		if (ns > max.load())
+		{
+			max.store(ns);
+		}
+		QAtomicInteger<qint64> & h = histogram[bucket(ns)];
+		h.store(h.load() + 1);
+	}
+	QVstPlugin::ProcessStats snapshot() const
+	{
+		QVstPlugin::ProcessStats st;
+		if (reset.loadAcquire())
+		{
+			return st;
+		}
+		st.calls = calls.load();
+		st.samples = samples.load();
+		st.total = total.load();
+		st.min = min.load();
+		st.max = max.load();
+		st.histogram.resize(Buckets);
+		for (int k = 0; k < Buckets; k++)
+		{
+			st.histogram[k] = histogram[k].load();
+		}
+		return st;
+	}
+};
+
+// plugin's entry point
+typedef AEffect *(VSTCALLBACK *vstFuncPtr)(audioMasterCallback host);
+
+static QAtomicInt loads_count;
+
+struct QVstPlugin::Data: public QVstHostContext
+{
+	QAtomicInt ref;
+	QLibrary plugin;
+	AEffect * aeffect;
+	bool ok;
+	QWidget * edit_widget;
+	float samplerate;
+	int blocksize;
+	bool bypass;
+	bool suspended;
+	int chainindex;
+	int tailsize;
+	qint64 silence;
+	bool skipping;
+	bool hostbypass;
+	int xfade;
+	int xfadepos;
+	QList< DelayLine<float> > fdelays;
+	QList< DelayLine<double> > ddelays;
+	PlanarScratch<float> fplanar;
+	PlanarScratch<double> dplanar;
+	bool fixedblock;
+	int fifofill;
+	PlanarScratch<float> ffifo;
+	PlanarScratch<double> dfifo;
+	bool ftz;
+	bool detectdenormals;
+	QAtomicInteger<qint64> denormals;
+	bool profiling;
+	ProcessCounters counters;
+	QVector<float> fdiscard;
+	QVector<double> ddiscard;
+	QList< QVector<float> > routing; // set by QVstChain
+	QList<VstPinProperties> inpins;
+	QList<VstPinProperties> outpins;
+	int precision;
+	bool doubleprecision;
+	Data(): ref(1), aeffect(0), ok (false), edit_widget(0), samplerate(8000), blocksize(4096), bypass(false), suspended(true), chainindex(0), tailsize(0), silence(0), skipping(false),
+		hostbypass(false), xfade(0), xfadepos(0), fixedblock(false), fifofill(0), ftz(false), detectdenormals(false), denormals(0), profiling(false), precision(-1), doubleprecision(false)
+	{
+	}
+	VstIntPtr dispatch(VstInt32 opcode, VstInt32 index, VstIntPtr value, void * ptr, float opt)
+	{
+		QVstTrace::Scope trace("dispatcher", QVstTrace::opcodeName(opcode), aeffect->uniqueID, index);
+		return aeffect->dispatcher(aeffect, opcode, index, value, ptr, opt);
+	}
+	void setPrecision(int p) // effSetProcessPrecision is only allowed while suspended, a resumed plugin keeps its precision
+	{
+		if (precision != p && suspended)
+		{
+			dispatch(effSetProcessPrecision, 0, p, NULL, 0.0f);
+			precision = p;
+		}
+	}
+	bool fifoActive() const // fixedblock as allocated at resume, for the current block size
+	{
+		return fixedblock && (ffifo.block == blocksize || dfifo.block == blocksize);
+	}
+	int delay() const
+	{
+		return initialdelay + (fifoActive() ? blocksize : 0);
+	}
+	PlanarScratch<float> & fifo(float)
+	{
+		return ffifo;
+	}
+	PlanarScratch<double> & fifo(double)
+	{
+		return dfifo;
+	}
+	void replacing(float ** in, float ** out, int count)
+	{
+		QVstTrace::Scope trace("process", "processReplacing", aeffect->uniqueID, count);
+		QVstAudit::Scope audit("plugin", true);
+		QElapsedTimer timer;
+		if (profiling)
+		{
+			timer.start();
+		}
+		aeffect->processReplacing(aeffect, in, out, count);
+		if (profiling)
+		{
+			counters.add(timer.nsecsElapsed(), count);
+		}
+	}
+	void replacing(double ** in, double ** out, int count)
+	{
+		QVstTrace::Scope trace("process", "processDoubleReplacing", aeffect->uniqueID, count);
+		QVstAudit::Scope audit("plugin", true);
+		QElapsedTimer timer;
+		if (profiling)
+		{
+			timer.start();
+		}
+		aeffect->processDoubleReplacing(aeffect, in, out, count);
+		if (profiling)
+		{
+			counters.add(timer.nsecsElapsed(), count);
+		}
+	}
+	template <class T>
+	void process(const T * const * in, T * const * out, int count);
+	template <class A, class B>
+	void processConverted(const A * const * in, A * const * out, int count, PlanarScratch<B> & s)
+	{
+		for (int offset = 0; offset < count && s.block > 0; offset += s.block)
+		{
+			const int n = qMin(s.block, count - offset);
+			for (int k = 0; k < s.inptr.count(); k++)
+			{
+				QVstSimd::convert(in[k] + offset, s.inptr[k], n);
+			}
+			process((const B * const *)s.inptr.constData(), s.outptr.constData(), n);
+			for (int k = 0; k < s.outptr.count(); k++)
+			{
+				QVstSimd::convert(s.outptr[k], out[k] + offset, n);
+			}
+		}
+	}
+	template <class T>
+	void countDenormals(T * const * out, int count)
+	{
+		qint64 n = 0;
+		for (int k = 0; k < aeffect->numOutputs; k++)
+		{
+			n += QVstSimd::denormals(out[k], count);
+		}
+		if (n > 0)
+		{
+			denormals.fetchAndAddRelaxed(n);
+		}
+	}
+	void refreshPins()
+	{
+		inpins.clear();
+		outpins.clear();
+		for (int i = 0; ok && i < aeffect->numInputs; i++)
+		{
+			VstPinProperties p;
+			memset(& p, 0, sizeof(p));
+			dispatch(effGetInputProperties, i, 0, & p, 0.0f);
+			inpins << p;
+		}
+		for (int i = 0; ok && i < aeffect->numOutputs; i++)
+		{
+			VstPinProperties p;
+			memset(& p, 0, sizeof(p));
+			dispatch(effGetOutputProperties, i, 0, & p, 0.0f);
+			outpins << p;
+		}
+		iochanged = false;
+	}
+	QWidget * widget()
+	{
+		if (!edit_widget)
+		{
+			edit_widget = new QWidget(0, Qt::Tool | Qt::MSWindowsOwnDC | Qt::MSWindowsFixedSizeDialogHint);
+			ERect * r = 0;
+			if (ok && dispatch(effEditGetRect, 0, 0, (void **)& r, 0.0f) && r)
+			{
+				edit_widget->resize(r->right - r->left, r->bottom - r->top);
+				edit_widget->move(r->left, r->top);
+			}
+		}
+		return edit_widget;
+	}
+	bool skipSilence(bool silent, int count, int default_tail)
+	{
+		if (!silent)
+		{
+			silence = 0;
+			skipping = false;
+			return false;
+		}
+		const qint64 silent_before = silence;
+		silence += count;
+		const int tail = (tailsize == 0) ? default_tail : (tailsize == 1 ? 0 : tailsize);
+		const bool skip = (tail >= 0 && silent_before >= tail + delay()); // the tail has left the fifo and the latency too
+		if (skip && !skipping)
+		{
+			clearDelays();
+		}
+		skipping = skip;
+		return skip;
+	}
+	void clearDelays() // nothing stale comes out when processing resumes
+	{
+		fifofill = 0;
+		ffifo.clear();
+		dfifo.clear();
+		for (int k = 0; k < fdelays.count(); k++)
+		{
+			fdelays[k].clear();
+		}
+		for (int k = 0; k < ddelays.count(); k++)
+		{
+			ddelays[k].clear();
+		}
+	}
+	QList< DelayLine<float> > & delays(float)
+	{
+		return fdelays;
+	}
+	QList< DelayLine<double> > & delays(double)
+	{
+		return ddelays;
+	}
+	bool bypassed() const
+	{
+		return hostbypass && xfadepos == 0;
+	}
+	template <class T>
+	void bypassMix(const T * const * in, int inputs, T * const * wet, T * const * dry, const T ** out, int outputs, int count);
+	~Data()
+	{
+		if (edit_widget)
+		{
+			edit_widget->deleteLater();
+		}
+	}
+};
+
+// host bypass: dry signal delayed by the plugin latency, crossfaded with the plugin output (wet) on toggle
+template <class T>
+void QVstPlugin::Data::bypassMix(const T * const * in, int inputs, T * const * wet, T * const * dry, const T ** out, int outputs, int count)
+{
+	QList< DelayLine<T> > & delay = delays(T());
+	const bool delayed = inputs > 0 && this->delay() > 0 && delay.count() >= outputs;
+	for (int k = 0; delayed && k < outputs; k++)
+	{
+		delay[k].setDelay(this->delay());
+	}
+	if (!hostbypass && xfadepos == 0)
+	{
+		for (int k = 0; delayed && k < outputs; k++)
+		{
+			delay[k].write(in[qMin(k, inputs - 1)], count);
+		}
+		for (int k = 0; k < outputs; k++)
+		{
+			out[k] = wet[k];
+		}
+		return;
+	}
+	for (int k = 0; k < outputs; k++)
+	{
+		if (inputs == 0)
+		{
+			memset(dry[k], 0, count * sizeof(T));
+			out[k] = dry[k];
+		}
+		else if (delayed)
+		{
+			delay[k].process(in[qMin(k, inputs - 1)], dry[k], count);
+			out[k] = dry[k];
+		}
+		else
+		{
+			out[k] = in[qMin(k, inputs - 1)];
+		}
+	}
+	if (xfadepos > 0)
+	{
+		const int start = xfade - xfadepos;
+		for (int k = 0; k < outputs; k++)
+		{
+			T * w = wet[k];
+			const T * o = out[k];
+			for (int n = 0; n < count; n++)
+			{
+				const T g = (start + n < xfade) ? T(start + n) / xfade : T(1);
+				w[n] += (o[n] - w[n]) * (hostbypass ? g : T(1) - g);
+			}
+			out[k] = w;
+		}
+	}
+	xfadepos = qMax(0, xfadepos - count);
+}
+
+// blocksize slices, or with fixedblock whole blocks through the fifo: the output lags the input by blocksize samples
+template <class T>
+void QVstPlugin::Data::process(const T * const * in, T * const * out, int count)
+{
+	const int inputs = aeffect->numInputs;
+	const int outputs = aeffect->numOutputs;
+	PlanarScratch<T> & f = fifo(T());
+	if (fixedblock && f.block == blocksize && f.inptr.count() == inputs && f.outptr.count() == outputs)
+	{
+		for (int done = 0; done < count; )
+		{
+			const int n = qMin(count - done, blocksize - fifofill);
+			for (int k = 0; k < inputs; k++)
+			{
+				memcpy(f.inptr[k] + fifofill, in[k] + done, n * sizeof(T));
+			}
+			for (int k = 0; k < outputs; k++)
+			{
+				memcpy(out[k] + done, f.outptr[k] + fifofill, n * sizeof(T));
+			}
+			fifofill += n;
+			done += n;
+			if (fifofill == blocksize)
+			{
+				replacing(f.inptr.data(), f.outptr.data(), blocksize);
+				fifofill = 0;
+			}
+		}
+		return;
+	}
+	QVarLengthArray<T *, 16> src(inputs);
+	QVarLengthArray<T *, 16> dst(outputs);
+	for (int offset = 0; offset < count; offset += blocksize)
+	{
+		for (int k = 0; k < inputs; k++)
+		{
+			src[k] = (T *)in[k] + offset;
+		}
+		for (int k = 0; k < outputs; k++)
+		{
+			dst[k] = out[k] + offset;
+		}
+		replacing(src.data(), dst.data(), qMin(blocksize, count - offset));
+	}
+}
+
+QVstPlugin::QVstPlugin(): d(new Data())
+{
+}
+
+QVstPlugin::QVstPlugin(const QString & name, const QString & preset): d(new Data())
+{
+	if (load(name))
+	{
+		if (!preset.isEmpty())
+		{
+			loadPreset(preset);
+		}
+	}
+}
+
+QVstPlugin::QVstPlugin(AEffect * effect): d(new Data())
+{
+	d->aeffect = effect;
+	d->ok = (effect && effect->magic == kEffectMagic);
+	if (!d->ok)
+	{
+		d->aeffect = 0;
+		return;
+	}
+	loads_count.ref();
+	d->aeffect->user = static_cast<QVstHostContext *>(d);
+	d->initialdelay = d->aeffect->initialDelay;
+	d->tailsize = d->dispatch(effGetTailSize, 0, 0, NULL, 0.0f);
+	d->dispatch(effOpen, 0, 0, NULL, 0.0f);
+	d->refreshPins();
+}
+
+QVstPlugin::QVstPlugin(const QVstPlugin & o): d(o.d)
+{
+	d->ref.ref();
+}
+
+QVstPlugin & QVstPlugin::operator = (const QVstPlugin & o)
+{
+	if (o.d != d)
+	{
+		o.d->ref.ref();
+		if (!d->ref.deref())
+		{
+			unload();
+			delete d;
+		}
+		d = o.d;
+	}
+	return * this;
+}
+
+#ifdef Q_COMPILER_RVALUE_REFS
+QVstPlugin::QVstPlugin(QVstPlugin && o): d(o.d)
+{
+	o.d = new Data();
+}
+
+QVstPlugin & QVstPlugin::operator = (QVstPlugin && o)
+{
+	qSwap(d, o.d);
+	return * this;
+}
+#endif
+
+QVstPlugin QVstPlugin::clone() const
+{
+	QVstPlugin vst;
+	if (isLoaded() && vstFileName().isEmpty())
+	{
+		vst = QVstPlugin((AEffect *)d->dispatch(effVendorSpecific, CloneEffect, 0, NULL, 0.0f));
+	}
+	else
+	{
+		vst.setVstFileName(vstFileName());
+	}
+	if (isLoaded() && (vst.isLoaded() || vst.load()))
+	{
+		vst.setParameters(parameters());
+		vst.setSampleRate(d->samplerate);
+		vst.setBlockSize(d->blocksize);
+	}
+	vst.d->samplerate = d->samplerate;
+	vst.d->blocksize = d->blocksize;
+	vst.d->chainindex = d->chainindex;
+	vst.d->routing = d->routing;
+	vst.d->fixedblock = d->fixedblock;
+	vst.d->doubleprecision = d->doubleprecision;
+	vst.d->ftz = d->ftz;
+	vst.d->detectdenormals = d->detectdenormals;
+	vst.d->profiling = d->profiling;
+	return vst;
+}
+
+bool QVstPlugin::isShared() const
+{
+	return d->ref.loadAcquire() > 1;
+}
+
+int QVstPlugin::loadsCount()
+{
+	return loads_count.loadAcquire();
+}
+
+QVstPlugin::~QVstPlugin()
+{
+	if (!d->ref.deref())
+	{
+		unload();
+		delete d;
+	}
+}
+
+bool QVstPlugin::load(const QString & name)
+{
+	setVstFileName(name);
+	return load();
+}
+
+void QVstPlugin::setVstFileName(const QString & name)
+{
+	if (d->plugin.fileName() != name)
+	{
+		unload();
+		d->plugin.setFileName(name);
+	}
+}
+
+QString QVstPlugin::vstFileName() const
+{
+	return d->plugin.fileName();
+}
+
+bool QVstPlugin::load()
+{
+	if (d->plugin.fileName().isEmpty())
+	{
+		return false;
+	}
+	unload();
+	d->plugin.load();
+	vstFuncPtr mainEntryPoint = (vstFuncPtr)d->plugin.resolve("VSTPluginMain");
+	if (mainEntryPoint == 0)
+	{
+		mainEntryPoint = (vstFuncPtr)d->plugin.resolve("main");
+	}
+	if (mainEntryPoint)
+	{
+		d->aeffect = mainEntryPoint(hostCallback);
+	}
+	if (!d->aeffect)
+	{
+		unload();
+		return false;
+	}
+	d->ok = (d->aeffect->magic == kEffectMagic);
+	if (!d->ok)
+	{
+		unload();
+		return false;
+	}
+	loads_count.ref();
+	d->aeffect->user = static_cast<QVstHostContext *>(d);
+	d->initialdelay = d->aeffect->initialDelay;
+	d->tailsize = d->dispatch(effGetTailSize, 0, 0, NULL, 0.0f);
+	d->dispatch(effOpen, 0, 0, NULL, 0.0f);
+	d->refreshPins();
+	return d->ok;
+
+}
+
+bool QVstPlugin::unload()
+{
+	if (d->ok)
+	{
+		d->dispatch(effClose, 0, 0, NULL, 0.0f);
+	}
+
+	d->aeffect = 0;
+	d->ok = false;
+	d->initialdelay = 0;
+	d->tailsize = 0;
+	d->precision = -1;
+	d->refreshPins();
+	if (d->plugin.isLoaded())
+	{
+		return d->plugin.unload();
+	}
+	return false;
+}
+
+bool QVstPlugin::isLoaded() const
+{
+	return d->ok;
+}
+
+const AEffect * QVstPlugin::lowLevelApi() const
+{
+	return d->aeffect;
+}
+
+void QVstPlugin::resume()
+{
+	if (!d->ok)
+	{
+		return;
+	}
+	d->setPrecision((d->doubleprecision || !canProcessFloat()) && canProcessDouble() ? kVstProcessPrecision64 : kVstProcessPrecision32);
+	d->dispatch(effMainsChanged, 0, 1, NULL, 0.0f);
+	d->dispatch(effStartProcess, 0, 0, NULL, 0.0f);
+	d->initialdelay = d->aeffect->initialDelay;
+	d->tailsize = d->dispatch(effGetTailSize, 0, 0, NULL, 0.0f);
+	d->silence = 0;
+	d->skipping = false;
+	d->refreshPins();
+	d->ffifo.allocate(d->aeffect->numInputs, d->aeffect->numOutputs, d->fixedblock && canProcessFloat() ? d->blocksize : 0);
+	d->dfifo.allocate(d->aeffect->numInputs, d->aeffect->numOutputs, d->fixedblock && canProcessDouble() ? d->blocksize : 0);
+	d->fifofill = 0;
+	d->fdelays.clear();
+	d->ddelays.clear();
+	for (int i = 0; d->delay() > 0 && i < d->aeffect->numOutputs; i++)
+	{
+		d->fdelays << DelayLine<float>();
+		d->fdelays.back().setDelay(d->delay());
+		d->ddelays << DelayLine<double>();
+		d->ddelays.back().setDelay(d->delay());
+	}
+	d->fplanar.allocate(d->aeffect->numInputs, d->aeffect->numOutputs, canProcessFloat() ? d->blocksize : 0);
+	d->dplanar.allocate(d->aeffect->numInputs, d->aeffect->numOutputs, canProcessDouble() ? d->blocksize : 0);
+	d->fdiscard.resize(canProcessFloat() && d->aeffect->numOutputs > 1 ? d->blocksize : 0);
+	d->ddiscard.resize(canProcessDouble() && d->aeffect->numOutputs > 1 ? d->blocksize : 0);
+	d->suspended = false;
+}
+
+void QVstPlugin::suspend()
+{
+	if (!d->ok)
+	{
+		return;
+	}
+	d->dispatch(effStopProcess, 0, 0, NULL, 0.0f);
+	d->dispatch(effMainsChanged, 0, 0, NULL, 0.0f);
+	d->suspended = true;
+}
+
+bool QVstPlugin::isSuspended() const
+{
+	return d->suspended;
+}
+
+bool QVstPlugin::canDo(const QString & canDoString)
+{
+	if (!d->ok)
+	{
+		return false;
+	}
+	char str[1024];
+	qstrcpy(str, canDoString.toLocal8Bit().constData());
+	return (d->dispatch(effCanDo, 0, 0, str, 0.0f) > 0);
+}
+
+void QVstPlugin::setSampleRate(float sr)
+{
+	if (!d->ok)
+	{
+		return;
+	}
+	d->dispatch(effSetSampleRate, 0, 0, NULL,  d->samplerate = sr);
+}
+
+float QVstPlugin::sampleRate() const
+{
+	return d->samplerate;
+}
+
+void QVstPlugin::setBlockSize(int sz)
+{
+	if (!d->ok)
+	{
+		return;
+	}
+	d->dispatch(effSetBlockSize, 0, d->blocksize = sz, NULL, 0.0f);
+}
+
+int QVstPlugin::blockSize() const
+{
+	return d->blocksize;
+}
+
+void QVstPlugin::setBypass(bool state)
+{
+	if (!d->ok)
+	{
+		return;
+	}
+	d->dispatch(effSetBypass, 0, d->bypass = (state ? 1 : 0), NULL, 0.0f);
+}
+
+bool QVstPlugin::bypass() const
+{
+	return d->bypass;
+}
+
+void QVstPlugin::setHostBypass(bool state)
+{
+	if (d->hostbypass == state)
+	{
+		return;
+	}
+	d->xfadepos = (d->xfade > 0) ? d->xfade - d->xfadepos : 0;
+	d->hostbypass = state;
+}
+
+bool QVstPlugin::hostBypass() const
+{
+	return d->hostbypass;
+}
+
+void QVstPlugin::setBypassCrossfade(int samples)
+{
+	d->xfade = qMax(0, samples);
+	d->xfadepos = qMin(d->xfadepos, d->xfade);
+}
+
+int QVstPlugin::bypassCrossfade() const
+{
+	return d->xfade;
+}
+
+int QVstPlugin::initialDelay() const
+{
+	if (!d->ok)
+	{
+		return 0;
+	}
+	return d->initialdelay;
+}
+
+void QVstPlugin::setFixedBlock(bool state)
+{
+	d->fixedblock = state;
+}
+
+bool QVstPlugin::fixedBlock() const
+{
+	return d->fixedblock;
+}
+
+void QVstPlugin::setDoublePrecision(bool state)
+{
+	d->doubleprecision = state;
+}
+
+bool QVstPlugin::doublePrecision() const
+{
+	return d->doubleprecision;
+}
+
+int QVstPlugin::latency() const
+{
+	if (!d->ok)
+	{
+		return 0;
+	}
+	return d->delay();
+}
+
+void QVstPlugin::setFlushDenormals(bool state)
+{
+	d->ftz = state;
+}
+
+bool QVstPlugin::flushDenormals() const
+{
+	return d->ftz;
+}
+
+void QVstPlugin::setDenormalDetection(bool state)
+{
+	d->detectdenormals = state;
+}
+
+bool QVstPlugin::denormalDetection() const
+{
+	return d->detectdenormals;
+}
+
+qint64 QVstPlugin::denormalsCount() const
+{
+	return d->denormals.loadAcquire();
+}
+
+void QVstPlugin::resetDenormalsCount()
+{
+	d->denormals.fetchAndStoreRelease(0);
+}
+
+QVstPlugin::ProcessStats::ProcessStats(): calls(0), samples(0), total(0), min(0), max(0)
+{
+}
+
+double QVstPlugin::ProcessStats::nsPerSample() const
+{
+	return (samples > 0) ? (double)total / samples : 0.0;
+}
+
+QVstPlugin::ProcessStats & QVstPlugin::ProcessStats::operator += (const ProcessStats & o)
 {
-	QLibrary plugin;
-	AEffect * aeffect;
-	bool ok;
-	QWidget * edit_widget;
-	float samplerate;
-	int blocksize;
-	bool bypass;
-	bool suspended;
-	int chainindex;
-	Data(): samplerate(8000), blocksize(4096), bypass(false), suspended(true), chainindex(0), ok (false)
+	if (o.calls == 0)
 	{
-		edit_widget = new QWidget(0, Qt::Tool | Qt::MSWindowsOwnDC | Qt::MSWindowsFixedSizeDialogHint);
+		return * this;
 	}
-	~Data()
+	min = (calls == 0) ? o.min : qMin(min, o.min);
+	max = qMax(max, o.max);
+	calls += o.calls;
+	samples += o.samples;
+	total += o.total;
+	histogram.resize(qMax(histogram.count(), o.histogram.count()));
+	for (int k = 0; k < o.histogram.count(); k++)
 	{
-		edit_widget->deleteLater();
+		histogram[k] += o.histogram[k];
 	}
-};
+	return * this;
+}
 
-QVstPlugin::QVstPlugin(): d(new Data())
+void QVstPlugin::setProfiling(bool state)
 {
+	d->profiling = state;
 }
 
-QVstPlugin::QVstPlugin(const QString & name, const QString & preset): d(new Data())
+bool QVstPlugin::profiling() const
 {
-	if (load(name))
+	return d->profiling;
+}
+
+QVstPlugin::ProcessStats QVstPlugin::processStats() const
+{
+	return d->counters.snapshot();
+}
+
+void QVstPlugin::resetProcessStats()
+{
+	d->counters.reset.storeRelease(1);
+}
+
+int QVstPlugin::tailSize() const
+{
+	if (!d->ok)
 	{
-		if (!preset.isEmpty())
-		{
-			loadPreset(preset);
-		}
+		return 0;
 	}
+	return d->tailsize;
+}
+
+QWidget * QVstPlugin::editWidget() const
+{
+	return d->widget();
 }
 
-QVstPlugin::QVstPlugin(const QVstPlugin & o): d(new Data())
+void QVstPlugin::editOpen()
 {
-	setVstFileName(o.vstFileName());
-	if (o.isLoaded())
+	if (!d->ok)
 	{
-		load();
-		setParameters(o.parameters());
+		return;
 	}
-	d->samplerate = o.d->samplerate;
-	d->blocksize = o.d->blocksize;
+	d->widget()->show();
+	d->dispatch(effEditOpen, 0, 0, (void*)d->widget()->winId(), 0.0f);
 }
 
-QVstPlugin & QVstPlugin::operator = (const QVstPlugin & o)
+void QVstPlugin::editClose()
 {
-	if (& o != this)
+	if (!d->ok)
 	{
-		setVstFileName(o.vstFileName());
-		if (o.isLoaded())
-		{
-			unload();
-			load();
-			setParameters(o.parameters());
-		}
-		d->samplerate = o.d->samplerate;
-		d->blocksize = o.d->blocksize;
+		return;
 	}
-	return * this;
+	d->widget()->hide();
+	d->dispatch(effEditClose, 0, 0, NULL, 0.0f);
 }
 
-QVstPlugin::~QVstPlugin()
+int QVstPlugin::inputsCount() const
 {
-	unload();
-	delete d;
+	if (!d->ok)
+	{
+		return 0;
+	}
+	return d->aeffect->numInputs;
 }
 
-bool QVstPlugin::load(const QString & name)
+int QVstPlugin::outputsCount() const
 {
-	setVstFileName(name);
-	return load();
+	if (!d->ok)
+	{
+		return 0;
+	}
+	return d->aeffect->numOutputs;
 }
 
-void QVstPlugin::setVstFileName(const QString & name)
+QList<VstPinProperties> QVstPlugin::inputs() const
 {
-	if (d->plugin.fileName() != name)
+	if (d->iochanged)
 	{
-		unload();
-		d->plugin.setFileName(name);
+		d->refreshPins();
 	}
+	return d->inpins;
 }
 
-QString QVstPlugin::vstFileName() const
+QList<VstPinProperties> QVstPlugin::outputs() const
 {
-	return d->plugin.fileName();
+	if (d->iochanged)
+	{
+		d->refreshPins();
+	}
+	return d->outpins;
+}
+
+// speakers of the standard arrangements, VstSpeakerArrangementType order
+static const int arrangement_speakers[kNumSpeakerArr][13] =
+{
+	{1, kSpeakerM},
+	{2, kSpeakerL, kSpeakerR},
+	{2, kSpeakerLs, kSpeakerRs},
+	{2, kSpeakerLc, kSpeakerRc},
+	{2, kSpeakerSl, kSpeakerSr},
+	{2, kSpeakerC, kSpeakerLfe},
+	{3, kSpeakerL, kSpeakerR, kSpeakerC},
+	{3, kSpeakerL, kSpeakerR, kSpeakerS},
+	{4, kSpeakerL, kSpeakerR, kSpeakerC, kSpeakerLfe},
+	{4, kSpeakerL, kSpeakerR, kSpeakerLfe, kSpeakerS},
+	{4, kSpeakerL, kSpeakerR, kSpeakerC, kSpeakerS},
+	{4, kSpeakerL, kSpeakerR, kSpeakerLs, kSpeakerRs},
+	{5, kSpeakerL, kSpeakerR, kSpeakerC, kSpeakerLfe, kSpeakerS},
+	{5, kSpeakerL, kSpeakerR, kSpeakerLfe, kSpeakerLs, kSpeakerRs},
+	{5, kSpeakerL, kSpeakerR, kSpeakerC, kSpeakerLs, kSpeakerRs},
+	{6, kSpeakerL, kSpeakerR, kSpeakerC, kSpeakerLfe, kSpeakerLs, kSpeakerRs},
+	{6, kSpeakerL, kSpeakerR, kSpeakerC, kSpeakerLs, kSpeakerRs, kSpeakerCs},
+	{6, kSpeakerL, kSpeakerR, kSpeakerLs, kSpeakerRs, kSpeakerSl, kSpeakerSr},
+	{7, kSpeakerL, kSpeakerR, kSpeakerC, kSpeakerLfe, kSpeakerLs, kSpeakerRs, kSpeakerCs},
+	{7, kSpeakerL, kSpeakerR, kSpeakerLfe, kSpeakerLs, kSpeakerRs, kSpeakerSl, kSpeakerSr},
+	{7, kSpeakerL, kSpeakerR, kSpeakerC, kSpeakerLs, kSpeakerRs, kSpeakerLc, kSpeakerRc},
+	{7, kSpeakerL, kSpeakerR, kSpeakerC, kSpeakerLs, kSpeakerRs, kSpeakerSl, kSpeakerSr},
+	{8, kSpeakerL, kSpeakerR, kSpeakerC, kSpeakerLfe, kSpeakerLs, kSpeakerRs, kSpeakerLc, kSpeakerRc},
+	{8, kSpeakerL, kSpeakerR, kSpeakerC, kSpeakerLfe, kSpeakerLs, kSpeakerRs, kSpeakerSl, kSpeakerSr},
+	{8, kSpeakerL, kSpeakerR, kSpeakerC, kSpeakerLs, kSpeakerRs, kSpeakerLc, kSpeakerRc, kSpeakerCs},
+	{8, kSpeakerL, kSpeakerR, kSpeakerC, kSpeakerLs, kSpeakerRs, kSpeakerCs, kSpeakerSl, kSpeakerSr},
+	{9, kSpeakerL, kSpeakerR, kSpeakerC, kSpeakerLfe, kSpeakerLs, kSpeakerRs, kSpeakerLc, kSpeakerRc, kSpeakerCs},
+	{9, kSpeakerL, kSpeakerR, kSpeakerC, kSpeakerLfe, kSpeakerLs, kSpeakerRs, kSpeakerCs, kSpeakerSl, kSpeakerSr},
+	{12, kSpeakerL, kSpeakerR, kSpeakerC, kSpeakerLfe, kSpeakerLs, kSpeakerRs, kSpeakerTfl, kSpeakerTfc, kSpeakerTfr, kSpeakerTrl, kSpeakerTrr, kSpeakerLfe2}
+};
+
+static bool isArrangement(VstSpeakerArrangementType type)
+{
+	return (type == kSpeakerArrEmpty || (type >= 0 && type < kNumSpeakerArr));
 }
 
-bool QVstPlugin::load()
+// VstSpeakerArrangement with room for more than 8 speakers
+class SpeakerArrangement
 {
-	if (d->plugin.fileName().isEmpty())
+	QVector<char> bytes;
+public:
+	SpeakerArrangement(VstSpeakerArrangementType type)
 	{
-		return false;
+		const int count = QVstPlugin::speakersCount(type);
+		bytes = QVector<char>(sizeof(VstSpeakerArrangement) + qMax(0, count - 8) * sizeof(VstSpeakerProperties), 0);
+		VstSpeakerArrangement * a = data();
+		a->type = type;
+		a->numChannels = count;
+		for (int i = 0; i < count; i++)
+		{
+			a->speakers[i].type = arrangement_speakers[type][i + 1];
+		}
 	}
-	unload();
-	d->plugin.load();
-	vstFuncPtr mainEntryPoint = (vstFuncPtr)d->plugin.resolve("VSTPluginMain");
-	if (mainEntryPoint == 0)
+	VstSpeakerArrangement * data()
 	{
-		mainEntryPoint = (vstFuncPtr)d->plugin.resolve("main");
+		return (VstSpeakerArrangement *)bytes.data();
 	}
-	if (mainEntryPoint)
+};
+
+int QVstPlugin::speakersCount(VstSpeakerArrangementType type)
+{
+	if (type < 0 || type >= kNumSpeakerArr)
 	{
-		d->aeffect = mainEntryPoint(hostCallback);
+		return 0;
 	}
-	if (!d->aeffect)
+	return arrangement_speakers[type][0];
+}
+
+bool QVstPlugin::setSpeakerArrangement(VstSpeakerArrangementType input, VstSpeakerArrangementType output)
+{
+	if (!d->ok || !isArrangement(input) || !isArrangement(output))
 	{
-		unload();
 		return false;
 	}
-	d->ok = (d->aeffect->magic == kEffectMagic);
-	if (!d->ok)
+	const bool resumed = !d->suspended;
+	if (resumed)
 	{
-		unload();
+		suspend();
 	}
-	d->aeffect->user = d->edit_widget;
-	ERect * r;
-	d->aeffect->dispatcher(d->aeffect, effEditGetRect, 0, 0, (void **)& r, 0.0f);
-	d->edit_widget->resize(r->right - r->left, r->bottom - r->top);
-	d->edit_widget->move(r->left, r->top);
-	d->aeffect->dispatcher(d->aeffect, effOpen, 0, 0, NULL, 0.0f);
-	return d->ok;
-
+	SpeakerArrangement in(input);
+	SpeakerArrangement out(output);
+	const bool accepted = d->dispatch(effSetSpeakerArrangement, 0, (VstIntPtr)in.data(), out.data(), 0.0f) != 0;
+	d->refreshPins();
+	if (resumed)
+	{
+		resume();
+	}
+	return accepted && d->aeffect->numInputs == speakersCount(input) && d->aeffect->numOutputs == speakersCount(output);
 }
 
-bool QVstPlugin::unload()
+VstSpeakerArrangementType QVstPlugin::inputArrangement() const
 {
-	if (d->ok)
+	VstSpeakerArrangement * in = 0;
+	VstSpeakerArrangement * out = 0;
+	if (!d->ok || !d->dispatch(effGetSpeakerArrangement, 0, (VstIntPtr)& in, & out, 0.0f) || !in)
 	{
-		d->aeffect->dispatcher(d->aeffect, effClose, 0, 0, NULL, 0.0f);
+		return kSpeakerArrEmpty;
 	}
+	return (VstSpeakerArrangementType)in->type;
+}
 
-	d->aeffect = 0;
-	d->ok = false;
-	if (d->plugin.isLoaded())
+VstSpeakerArrangementType QVstPlugin::outputArrangement() const
+{
+	VstSpeakerArrangement * in = 0;
+	VstSpeakerArrangement * out = 0;
+	if (!d->ok || !d->dispatch(effGetSpeakerArrangement, 0, (VstIntPtr)& in, & out, 0.0f) || !out)
 	{
-		return d->plugin.unload();
+		return kSpeakerArrEmpty;
 	}
-	return false;
+	return (VstSpeakerArrangementType)out->type;
 }
 
-bool QVstPlugin::isLoaded() const
+bool QVstPlugin::isGenerator() const
 {
-	return d->ok;
+	if (!d->ok)
+	{
+		return false;
+	}
+	return inputsCount() == 0;
 }
 
-const AEffect * QVstPlugin::lowLevelApi() const
+int QVstPlugin::programsCount() const
 {
-	return d->aeffect;
+	if (!d->ok)
+	{
+		return 0;
+	}
+	return d->aeffect->numPrograms;
 }
 
-void QVstPlugin::resume()
+void QVstPlugin::setProgram(int i, const QString * new_program_name)
 {
 	if (!d->ok)
 	{
 		return;
 	}
-	d->aeffect->dispatcher(d->aeffect, effMainsChanged, 0, 1, NULL, 0.0f);
-	d->aeffect->dispatcher(d->aeffect, effStartProcess, 0, 0, NULL, 0.0f);
-	d->suspended = false;
+	if (i < 0 || i >= programsCount())
+	{
+		return;
+	}
+	d->dispatch(effBeginSetProgram, 0, 0, NULL, 0.0f);
+	d->dispatch(effSetProgram, 0, i, NULL, 0.0f);
+	d->dispatch(effEndSetProgram, 0, 0, NULL, 0.0f);
+	if (new_program_name)
+	{
+		char name[kVstMaxProgNameLen + 1];
+		qstrcpy(name, new_program_name->toLocal8Bit().constData());
+		d->dispatch(effSetProgramName, 0, i, NULL, 0.0f);
+	}
 }
 
-void QVstPlugin::suspend()
+int QVstPlugin::program(QString * program_name) const
 {
 	if (!d->ok)
 	{
-		return;
+		return 0;
 	}
-	d->aeffect->dispatcher(d->aeffect, effStopProcess, 0, 0, NULL, 0.0f);
-	d->aeffect->dispatcher(d->aeffect, effMainsChanged, 0, 0, NULL, 0.0f);
-	d->suspended = true;
+	if (program_name)
+	{
+		char name[kVstMaxProgNameLen + 1];
+		d->dispatch(effSetProgramName, 0, 0, name, 0.0f);
+		* program_name = name;
+	}
+	return d->dispatch(effGetProgram, 0, 0, NULL, 0.0f);
 }
 
-bool QVstPlugin::isSuspended() const
+QStringList QVstPlugin::programs() const
 {
-	return d->suspended;
+	QStringList l;
+	for (int i = 0; i < programsCount(); i++)
+	{
+		char name[kVstMaxProgNameLen + 1];
+		d->dispatch(effGetProgramNameIndexed, 0, i, name, 0.0f);
+		l << name;
+	}
+	return l;
 }
 
-bool QVstPlugin::canDo(const QString & canDoString)
+void QVstPlugin::savePreset(QSettings & s) const
+{
+	if (!d->ok)
+	{
+		return;
+	}
+	s.beginGroup(QString::number(d->chainindex) + "_" + QString::number(id()));
+	s.setValue("EffectName", effectName());
+	s.setValue("Id", id());
+	s.setValue("VstVersion", vstVersion());
+	s.setValue("PluginVersion", pluginVersion());
+	s.setValue("VendorVersion", vendorVersion());
+	s.setValue("BlockSize", blockSize());
+	s.setValue("SampleRate", QString::number(sampleRate()));
+	for (int i = 0; i < parametersCount(); i++)
+	{
+		s.setValue(QString::number(i), QString::number(parameter(i)));
+	}
+	s.endGroup();
+}
+
+bool QVstPlugin::loadPreset(QSettings & s)
 {
 	if (!d->ok)
 	{
 		return false;
 	}
-	char str[1024];
-	qstrcpy(str, canDoString.toLocal8Bit().constData());
-	return (d->aeffect->dispatcher(d->aeffect, effCanDo, 0, 0, str, 0.0f) > 0);
+	s.beginGroup(QString::number(d->chainindex) + "_" + QString::number(id()));
+	const bool valid = s.value("Id").toInt() == id();
+	s.endGroup();
+	if (!valid)
+	{
+		return false;
+	}
+	s.beginGroup(QString::number(d->chainindex) + "_" + QString::number(id()));
+	setBlockSize(s.value("BlockSize").toInt());
+	setSampleRate(s.value("SampleRate").toFloat());
+	for (int i = 0; i < parametersCount(); i++)
+	{
+		setParameter(i, s.value(QString::number(i)).toFloat());
+	}
+	s.endGroup();
+	return true;
 }
 
-void QVstPlugin::setSampleRate(float sr)
+void QVstPlugin::savePreset(const QString & name) const
 {
 	if (!d->ok)
 	{
 		return;
 	}
-	d->aeffect->dispatcher(d->aeffect, effSetSampleRate, 0, 0, NULL,  d->samplerate = sr);
+//	QSettings(name, QSettings::IniFormat).clear();
+	QSettings s(name, QSettings::IniFormat);
+	savePreset(s);
 }
 
-float QVstPlugin::sampleRate() const
+bool QVstPlugin::loadPreset(const QString & name)
 {
-	return d->samplerate;
+	QSettings s(name, QSettings::IniFormat);
+	return loadPreset(s);
 }
 
-void QVstPlugin::setBlockSize(int sz)
+int QVstPlugin::parametersCount() const
 {
 	if (!d->ok)
 	{
-		return;
+		return 0;
 	}
-	d->aeffect->dispatcher(d->aeffect, effSetBlockSize, 0, d->blocksize = sz, NULL, 0.0f);
+	return d->aeffect->numParams;
 }
 
-int QVstPlugin::blockSize() const
+void QVstPlugin::setParameter(int i, float value)
 {
-	return d->blocksize;
+	if (!d->ok)
+	{
+		return;
+	}
+	if (i < 0 || i >= parametersCount())
+	{
+		return;
+	}
+	QVstTrace::Scope trace("parameter", "setParameter", d->aeffect->uniqueID, i);
+	d->aeffect->setParameter(d->aeffect, i, value);
 }
 
-void QVstPlugin::setBypass(bool state)
+float QVstPlugin::parameter(int i, VstParameterProperties * properties) const
 {
 	if (!d->ok)
 	{
-		return;
+		return 0.0f;
+	}
+	if (i < 0 || i >= parametersCount())
+	{
+		return 0.0f;
+	}
+	if (properties)
+	{
+		memset(properties, 0, sizeof(* properties));
+		d->dispatch(effGetParameterProperties, i, 0, properties, 0.0f);
 	}
-	d->aeffect->dispatcher(d->aeffect, effSetBypass, 0, d->bypass = (state ? 1 : 0), NULL, 0.0f);
+	QVstTrace::Scope trace("parameter", "getParameter", d->aeffect->uniqueID, i);
+	return d->aeffect->getParameter(d->aeffect, i);
 }
 
-bool QVstPlugin::bypass() const
+void QVstPlugin::setParameters(const QList<float> & l)
 {
-	return d->bypass;
+	for (int i = 0; i < qMin(parametersCount(), l.count()); i++)
+	{
+		setParameter(i, l[i]);
+	}
 }
 
-QWidget * QVstPlugin::editWidget() const
+QList<float> QVstPlugin::parameters(QList<VstParameterProperties> * properties) const
 {
-	return d->edit_widget;
+	QList<float> l;
+	for (int i = 0; i < parametersCount(); i++)
+	{
+		VstParameterProperties p;
+		const float v = parameter(i, & p);
+		if (properties)
+		{
+			* properties << p;
+		}
+		l << v;
+	}
+	return l;
 }
 
-void QVstPlugin::editOpen()
+int QVstPlugin::id() const
 {
 	if (!d->ok)
 	{
-		return;
+		return 0;
 	}
-	d->edit_widget->show();
-	d->aeffect->dispatcher(d->aeffect, effEditOpen, 0, 0, (void*)d->edit_widget->winId(), 0.0f);
+	return d->aeffect->uniqueID;
 }
 
-void QVstPlugin::editClose()
+int QVstPlugin::pluginVersion() const
 {
 	if (!d->ok)
 	{
-		return;
+		return 0;
 	}
-	d->edit_widget->hide();
-	d->aeffect->dispatcher(d->aeffect, effEditClose, 0, 0, NULL, 0.0f);
+	return d->aeffect->version;
 }
 
-int QVstPlugin::inputsCount() const
+int QVstPlugin::vstVersion() const
 {
 	if (!d->ok)
 	{
 		return 0;
 	}
-	return d->aeffect->numInputs;
+	return d->dispatch(effGetVstVersion, 0, 0, NULL, 0.0f);
 }
 
-int QVstPlugin::outputsCount() const
+int QVstPlugin::vendorVersion() const
 {
 	if (!d->ok)
 	{
 		return 0;
 	}
-	return d->aeffect->numOutputs;
+	return d->dispatch(effGetVendorVersion, 0, 0, NULL, 0.0f);
 }
 
-QList<VstPinProperties> QVstPlugin::inputs() const
+QString QVstPlugin::effectName() const
 {
-	QList<VstPinProperties> l;
-	for (int i = 0; i < inputsCount(); i++)
+	if (!d->ok)
 	{
-		VstPinProperties p;
-		qMemSet(& p, 0, sizeof(p));
-		d->aeffect->dispatcher(d->aeffect, effGetInputProperties, 0, 0, & p, 0.0f);
-		l << p;
+		return 0;
 	}
-	return l;
+	char name[kVstMaxEffectNameLen + 1];
+	name[0] = '\0';
+	d->dispatch(effGetEffectName, 0, 0, name, 0.0f);
+	return name;
 }
 
-QList<VstPinProperties> QVstPlugin::outputs() const
+VstPlugCategory QVstPlugin::category() const
 {
-	QList<VstPinProperties> l;
-	for (int i = 0; i < outputsCount(); i++)
+	if (!d->ok)
 	{
-		VstPinProperties p;
-		qMemSet(& p, 0, sizeof(p));
-		d->aeffect->dispatcher(d->aeffect, effGetOutputProperties, 0, 0, & p, 0.0f);
-		l << p;
+		return kPlugCategUnknown;
 	}
-	return l;
+	return (VstPlugCategory)d->dispatch(effGetPlugCategory, 0, 0, NULL, 0.0f);
 }
 
-bool QVstPlugin::isGenerator() const
+bool QVstPlugin::canProcessFloat() const
 {
 	if (!d->ok)
 	{
 		return false;
 	}
-	return inputsCount() == 0;
+	return (d->aeffect->flags & effFlagsCanReplacing) == effFlagsCanReplacing;
 }
 
-int QVstPlugin::programsCount() const
+bool QVstPlugin::canProcessDouble() const
 {
 	if (!d->ok)
 	{
-		return 0;
+		return false;
 	}
-	return d->aeffect->numPrograms;
+	return (d->aeffect->flags & effFlagsCanDoubleReplacing) == effFlagsCanDoubleReplacing;
 }
 
-void QVstPlugin::setProgram(int i, const QString * new_program_name)
+bool QVstPlugin::process(const float ** input, float ** output, int count)
 {
 	if (!d->ok)
 	{
-		return;
+		return false;
 	}
-	if (i < 0 || i >= programsCount())
+	if (!canProcessFloat())
 	{
-		return;
+		return false;
 	}
-	d->aeffect->dispatcher(d->aeffect, effBeginSetProgram, 0, 0, NULL, 0.0f);
-	d->aeffect->dispatcher(d->aeffect, effSetProgram, 0, i, NULL, 0.0f);
-	d->aeffect->dispatcher(d->aeffect, effEndSetProgram, 0, 0, NULL, 0.0f);
-	if (new_program_name)
+	QVstAudit::Scope audit("QVstPlugin::process");
+	QVstDenormalGuard guard(d->ftz);
+	d->setPrecision(kVstProcessPrecision32);
+	if (d->precision == kVstProcessPrecision64)
 	{
-		char name[kVstMaxProgNameLen + 1];
-		qstrcpy(name, new_program_name->toLocal8Bit().constData());
-		d->aeffect->dispatcher(d->aeffect, effSetProgramName, 0, i, NULL, 0.0f);
+		d->processConverted(input, output, count, d->dplanar);
+	}
+	else
+	{
+		d->process(input, output, count);
+	}
+	if (d->detectdenormals)
+	{
+		d->countDenormals(output, count);
 	}
+	return true;
 }
 
-int QVstPlugin::program(QString * program_name) const
+bool QVstPlugin::process(const double ** input, double ** output, int count)
 {
 	if (!d->ok)
 	{
-		return 0;
+		return false;
 	}
-	if (program_name)
+	if (!canProcessDouble())
 	{
-		char name[kVstMaxProgNameLen + 1];
-		d->aeffect->dispatcher(d->aeffect, effSetProgramName, 0, 0, name, 0.0f);
-		* program_name = name;
+		return false;
+	}
+	QVstAudit::Scope audit("QVstPlugin::process");
+	QVstDenormalGuard guard(d->ftz);
+	d->setPrecision(kVstProcessPrecision64);
+	if (d->precision == kVstProcessPrecision32)
+	{
+		d->processConverted(input, output, count, d->fplanar);
+	}
+	else
+	{
+		d->process(input, output, count);
+	}
+	if (d->detectdenormals)
+	{
+		d->countDenormals(output, count);
 	}
-	return d->aeffect->dispatcher(d->aeffect, effGetProgram, 0, 0, NULL, 0.0f);
+	return true;
 }
 
-QStringList QVstPlugin::programs() const
+bool QVstPlugin::processInterleaved(const float * input, float * output, int frames)
 {
-	QStringList l;
-	for (int i = 0; i < programsCount(); i++)
+	if (!d->ok)
 	{
-		char name[kVstMaxProgNameLen + 1];
-		d->aeffect->dispatcher(d->aeffect, effGetProgramNameIndexed, 0, i, name, 0.0f);
-		l << name;
+		return false;
 	}
-	return l;
+	return ::processInterleaved(* this, d->fplanar, input, output, frames);
 }
 
-void QVstPlugin::savePreset(QSettings & s) const
+bool QVstPlugin::processInterleaved(const double * input, double * output, int frames)
 {
 	if (!d->ok)
 	{
-		return;
+		return false;
 	}
-	s.beginGroup(QString::number(d->chainindex) + "_" + QString::number(id()));
-	s.setValue("EffectName", effectName());
-	s.setValue("Id", id());
-	s.setValue("VstVersion", vstVersion());
-	s.setValue("PluginVersion", pluginVersion());
-	s.setValue("VendorVersion", vendorVersion());
-	s.setValue("BlockSize", blockSize());
-	s.setValue("SampleRate", QString::number(sampleRate()));
-	for (int i = 0; i < parametersCount(); i++)
+	return ::processInterleaved(* this, d->dplanar, input, output, frames);
+}
+
+bool QVstPlugin::process(const QVstAudioBuffer<float> & in, QVstAudioBuffer<float> & out)
+{
+	if (!d->ok)
 	{
-		s.setValue(QString::number(i), QString::number(parameter(i)));
+		return false;
 	}
-	s.endGroup();
+	return processBuffer(* this, in, out);
 }
 
-bool QVstPlugin::loadPreset(QSettings & s)
+bool QVstPlugin::process(const QVstAudioBuffer<double> & in, QVstAudioBuffer<double> & out)
 {
 	if (!d->ok)
 	{
 		return false;
 	}
-	s.beginGroup(QString::number(d->chainindex) + "_" + QString::number(id()));
-	const bool valid = s.value("Id").toInt() == id();
-	s.endGroup();
-	if (!valid)
+	return processBuffer(* this, in, out);
+}
+
+QList< QVector<float> > QVstPlugin::process(const QList< QVector<float> > & in)
+{
+	QList< QVector<float> > out;
+	if (in.count() != d->aeffect->numInputs || !canProcessFloat())
 	{
-		return false;
+		return out;
 	}
-	s.beginGroup(QString::number(d->chainindex) + "_" + QString::number(id()));
-	setBlockSize(s.value("BlockSize").toInt());
-	setSampleRate(s.value("SampleRate").toFloat());
-	for (int i = 0; i < parametersCount(); i++)
+	QVarLengthArray<const float *, 16> inputs(d->aeffect->numInputs);
+	QVarLengthArray<float *, 16> outputs(d->aeffect->numOutputs);
+	int count = 0;
+	for (int i = 0; i < d->aeffect->numInputs; i++)
 	{
-		setParameter(i, s.value(QString::number(i)).toFloat());
+		inputs[i] = in[i].constData();
+		if (count == 0 || in[i].count() < count)
+		{
+			count = in[i].count();
+		}
 	}
-	s.endGroup();
-	return true;
+	if (d->aeffect->numInputs == 0)
+	{
+		count = d->blocksize;
+	}
+	if (count > 0)
+	{
+		for (int i = 0; i < d->aeffect->numOutputs; i++)
+		{
+			out << QVector<float>(count);
+			outputs[i] = (float *)out[i].data();
+		}
+		process(inputs.data(), outputs.data(), count);
+	}
+	return out;
 }
 
-void QVstPlugin::savePreset(const QString & name) const
+QList< QVector<double> > QVstPlugin::process(const QList< QVector<double> > & in)
 {
-	if (!d->ok)
+	QList< QVector<double> > out;
+	if (in.count() != d->aeffect->numInputs || !canProcessDouble())
 	{
-		return;
+		return out;
 	}
-//	QSettings(name, QSettings::IniFormat).clear();
-	savePreset(QSettings(name, QSettings::IniFormat));
+	QVarLengthArray<const double *, 16> inputs(d->aeffect->numInputs);
+	QVarLengthArray<double *, 16> outputs(d->aeffect->numOutputs);
+	int count = 0;
+	for (int i = 0; i < d->aeffect->numInputs; i++)
+	{
+		inputs[i] = in[i].constData();
+		if (count == 0 || in[i].count() < count)
+		{
+			count = in[i].count();
+		}
+	}
+	if (d->aeffect->numInputs == 0)
+	{
+		count = d->blocksize;
+	}
+	if (count > 0)
+	{
+		for (int i = 0; i < d->aeffect->numOutputs; i++)
+		{
+			out << QVector<double>(count);
+			outputs[i] = (double *)out[i].data();
+		}
+		process(inputs.data(), outputs.data(), count);
+	}
+	return out;
 }
 
-bool QVstPlugin::loadPreset(const QString & name)
+QVector<float> QVstPlugin::processOne(const QVector<float> & in)
 {
-	return loadPreset(QSettings(name, QSettings::IniFormat));
+	QVector<float> out;
+	if (!processOne(in, out))
+	{
+		return QVector<float>();
+	}
+	return out;
 }
 
-int QVstPlugin::parametersCount() const
+bool QVstPlugin::processOne(const QVector<float> & in, QVector<float> & out)
 {
 	if (!d->ok)
 	{
-		return 0;
+		return false;
 	}
-	return d->aeffect->numParams;
+	return ::processOne(* this, d->fdiscard, in, out);
 }
 
-void QVstPlugin::setParameter(int i, float value)
+QVector<double> QVstPlugin::processOne(const QVector<double> & in)
 {
-	if (!d->ok)
-	{
-		return;
-	}
-	if (i < 0 || i >= parametersCount())
+	QVector<double> out;
+	if (!processOne(in, out))
 	{
-		return;
+		return QVector<double>();
 	}
-	d->aeffect->setParameter(d->aeffect, i, value);
+	return out;
 }
 
-float QVstPlugin::parameter(int i, VstParameterProperties * properties) const
+bool QVstPlugin::processOne(const QVector<double> & in, QVector<double> & out)
 {
 	if (!d->ok)
 	{
-		return 0.0f;
+		return false;
 	}
-	if (i < 0 || i >= parametersCount())
+	return ::processOne(* this, d->ddiscard, in, out);
+}
+
+// ---------------------------------------------------------------------------------
+
+template <class T>
+static void trimLatency(QVector<T> & v, int & trim)
+{
+	if (trim <= 0)
 	{
-		return 0.0f;
+		return;
 	}
-	if (properties)
+	const int count = qMin(trim, v.count());
+	v.remove(0, count);
+	trim -= count;
+}
+
+template <class T>
+static void trimLatency(QList< QVector<T> > & l, int & trim)
+{
+	if (l.isEmpty() || trim <= 0)
 	{
-		qMemSet(properties, 0, sizeof(* properties));
-		d->aeffect->dispatcher(d->aeffect, effGetParameterProperties, i, 0, properties, 0.0f);
+		return;
 	}
-	return d->aeffect->getParameter(d->aeffect, i);
-}
+	const int count = qMin(trim, l.front().count());
+	for (int i = 0; i < l.count(); i++)
+	{
+		l[i].remove(0, count);
+	}
+	trim -= count;
+}
+
+// per precision buffers of a chain stage
+template <class T>
+struct StageBuffers
+{
+	QVector<T> wet; // plugin outputs
+	QVector<T> dry; // host bypass outputs
+	QVector<T> cvt; // inputs converted from the other precision
+	QVector<T> mix; // routed inputs mixed from several channels
+	QVector<const T *> in;
+	QVector<const T *> out;
+	QVector<T *> wetptr;
+	QVector<T *> dryptr;
+	QVector<T *> target;
+	void allocate(int inputs, int outputs, int block)
+	{
+		wet = QVector<T>(outputs * block, 0);
+		dry = QVector<T>(outputs * block, 0);
+		cvt = QVector<T>(inputs * block, 0);
+		in = QVector<const T *>(inputs);
+		out = QVector<const T *>(outputs);
+		wetptr = QVector<T *>(outputs);
+		dryptr = QVector<T *>(outputs);
+		target = QVector<T *>(outputs);
+		for (int k = 0; k < outputs; k++)
+		{
+			wetptr[k] = wet.data() + k * block;
+			dryptr[k] = dry.data() + k * block;
+		}
+	}
+};
 
-void QVstPlugin::setParameters(const QList<float> & l)
+// input pin source resolved at publish, a single unity gain route passes the pointer through
+struct ChainRoute
 {
-	for (int i = 0; i < qMin(parametersCount(), l.count()); i++)
+	enum { Silent = -1, Mix = -2 };
+	int source;
+	QVector<int> sources;
+	QVector<float> gains;
+	ChainRoute(): source(Silent)
 	{
-		setParameter(i, l[i]);
 	}
-}
+};
 
-QList<float> QVstPlugin::parameters(QList<VstParameterProperties> * properties) const
+struct ChainStage
 {
-	QList<float> l;
-	for (int i = 0; i < parametersCount(); i++)
+	QVstPlugin vst;
+	int inputs;
+	int outputs;
+	bool doubles;
+	QVector<ChainRoute> routes; // empty - default routing
+	bool mixes;
+	StageBuffers<float> f;
+	StageBuffers<double> d;
+	qint64 elapsed; // ns in the current process() call, deadline monitor only
+	ChainStage(): inputs(0), outputs(0), doubles(false), mixes(false), elapsed(0)
 	{
-		VstParameterProperties p;
-		const float v = parameter(i, & p);
-		if (properties)
+	}
+	void route(const QList< QVector<float> > & matrix)
+	{
+		routes.clear();
+		mixes = false;
+		if (matrix.isEmpty())
 		{
-			* properties << p;
+			return;
+		}
+		routes.resize(inputs);
+		for (int k = 0; k < inputs && k < matrix.count(); k++)
+		{
+			ChainRoute & r = routes[k];
+			for (int i = 0; i < matrix[k].count(); i++)
+			{
+				if (matrix[k][i] != 0.0f)
+				{
+					r.sources << i;
+					r.gains << matrix[k][i];
+				}
+			}
+			if (r.sources.count() == 1 && r.gains.front() == 1.0f)
+			{
+				r.source = r.sources.front();
+			}
+			else if (!r.sources.isEmpty())
+			{
+				r.source = ChainRoute::Mix;
+				mixes = true;
+			}
 		}
-		l << v;
 	}
-	return l;
-}
+	StageBuffers<float> & buffers(float)
+	{
+		return f;
+	}
+	StageBuffers<double> & buffers(double)
+	{
+		return d;
+	}
+};
 
-int QVstPlugin::id() const
+// signal flowing between the stages, either precision
+struct ChainSignal
 {
-	if (!d->ok)
+	const float * const * f;
+	const double * const * d;
+	int channels;
+	void set(const float * const * p, int c)
 	{
-		return 0;
+		f = p;
+		d = 0;
+		channels = c;
 	}
-	return d->aeffect->uniqueID;
-}
+	void set(const double * const * p, int c)
+	{
+		f = 0;
+		d = p;
+		channels = c;
+	}
+};
 
-int QVstPlugin::pluginVersion() const
+static const float * fromSignal(const ChainSignal & sig, int k, float * scratch, int count)
 {
-	if (!d->ok)
+	if (sig.f)
 	{
-		return 0;
+		return sig.f[k];
 	}
-	return d->aeffect->version;
+	QVstSimd::convert(sig.d[k], scratch, count);
+	return scratch;
 }
 
-int QVstPlugin::vstVersion() const
+static const double * fromSignal(const ChainSignal & sig, int k, double * scratch, int count)
 {
-	if (!d->ok)
+	if (sig.d)
 	{
-		return 0;
+		return sig.d[k];
 	}
-	return d->aeffect->dispatcher(d->aeffect, effGetVstVersion, 0, 0, NULL, 0.0f);
+	QVstSimd::convert(sig.f[k], scratch, count);
+	return scratch;
 }
 
-int QVstPlugin::vendorVersion() const
+template <class T>
+static void toOutput(const ChainSignal & sig, int k, T * out, int count)
 {
-	if (!d->ok)
+	if (sig.f)
 	{
-		return 0;
+		QVstSimd::convert(sig.f[k], out, count);
+	}
+	else
+	{
+		QVstSimd::convert(sig.d[k], out, count);
 	}
-	return d->aeffect->dispatcher(d->aeffect, effGetVendorVersion, 0, 0, NULL, 0.0f);
 }
 
-QString QVstPlugin::effectName() const
+static bool isDouble(float)
 {
-	if (!d->ok)
-	{
-		return 0;
-	}
-	char name[kVstMaxEffectNameLen + 1];
-	name[0] = '\0';
-	d->aeffect->dispatcher(d->aeffect, effGetEffectName, 0, 0, name, 0.0f);
-	return name;
+	return false;
 }
 
-VstPlugCategory QVstPlugin::category() const
+static bool isDouble(double)
 {
-	if (!d->ok)
-	{
-		return kPlugCategUnknown;
-	}
-	return (VstPlugCategory)d->aeffect->dispatcher(d->aeffect, effGetPlugCategory, 0, 0, NULL, 0.0f);
+	return true;
 }
 
-bool QVstPlugin::canProcessFloat() const
+static float * const * directOutput(float * const * out, float)
 {
-	if (!d->ok)
-	{
-		return false;
-	}
-	return (d->aeffect->flags & effFlagsCanReplacing) == effFlagsCanReplacing;
+	return out;
 }
 
-bool QVstPlugin::canProcessDouble() const
+static double * const * directOutput(double * const * out, double)
 {
-	if (!d->ok)
-	{
-		return false;
-	}
-	return (d->aeffect->flags & effFlagsCanDoubleReplacing) == effFlagsCanDoubleReplacing;
+	return out;
 }
 
-bool QVstPlugin::process(const float ** input, float ** output, int count)
+static double * const * directOutput(float * const *, double)
 {
-	if (!d->ok)
-	{
-		return false;
-	}
-	if (!canProcessFloat())
+	return 0;
+}
+
+static float * const * directOutput(double * const *, float)
+{
+	return 0;
+}
+
+// immutable snapshot of the chain used by process(), holds references to the plugin instances and preallocated buffers
+struct ChainPlan
+{
+	QVector<ChainStage> stages;
+	bool floats;
+	bool doubles;
+	bool mixed;
+	bool generator;
+	int links;
+	int block;
+	QVector<float> fzero;
+	QVector<double> dzero;
+	QVector<const float *> fin;
+	QVector<float *> fout;
+	QVector<const double *> din;
+	QVector<double *> dout;
+	PlanarScratch<float> fplanar;
+	PlanarScratch<double> dplanar;
+	ChainPlan * next;
+	ChainPlan(): floats(false), doubles(false), mixed(false), generator(false), links(0), block(1), next(0)
 	{
-		return false;
 	}
-	d->aeffect->dispatcher(d->aeffect, effSetProcessPrecision, 0, kVstProcessPrecision32, NULL, 0.0f);
-
-	const float ** tmp_input = d->aeffect->numInputs > 0 ? new const float * [d->aeffect->numInputs] : 0;
-	float ** tmp_output = d->aeffect->numOutputs > 0 ? new float * [d->aeffect->numOutputs] : 0;
-	for (int offset = 0; offset < count; offset += d->blocksize)
+	bool canProcess(int i) const
 	{
-		for (int i = 0; i < d->aeffect->numInputs; i++)
+		if (i < 0)
 		{
-			tmp_input[i] = input[i] + offset;
+			return false;
 		}
-		for (int i = 0; i < d->aeffect->numOutputs; i++)
+		if (i == 0)
 		{
-			tmp_output[i] = output[i] + offset;
+			return generator;
 		}
-		d->aeffect->processReplacing(d->aeffect, (float **)tmp_input, tmp_output, qMin(d->blocksize, count - offset));
+		return (i <= links);
 	}
-	if (d->aeffect->numInputs)
+	int latency() const
 	{
-		delete [] tmp_input;
+		int latency = 0;
+		for (int i = 0; i < stages.count(); i++)
+		{
+			latency += stages[i].vst.latency();
+		}
+		return latency;
 	}
-	if (d->aeffect->numOutputs)
+	bool supports(float) const
 	{
-		delete [] tmp_output;
+		return floats;
 	}
-	return true;
-}
-
-bool QVstPlugin::process(const double ** input, double ** output, int count)
-{
-	if (!d->ok)
+	bool supports(double) const
 	{
-		return false;
+		return doubles;
 	}
-	if (!canProcessDouble())
+	const float * zero(float) const
 	{
-		return false;
+		return fzero.constData();
+	}
+	const double * zero(double) const
+	{
+		return dzero.constData();
+	}
+	const float ** inputs(float)
+	{
+		return fin.data();
+	}
+	const double ** inputs(double)
+	{
+		return din.data();
+	}
+	float ** outputs(float)
+	{
+		return fout.data();
+	}
+	double ** outputs(double)
+	{
+		return dout.data();
+	}
+	PlanarScratch<float> & planar(float)
+	{
+		return fplanar;
 	}
-	d->aeffect->dispatcher(d->aeffect, effSetProcessPrecision, 0, kVstProcessPrecision32, NULL, 0.0f);
+	PlanarScratch<double> & planar(double)
+	{
+		return dplanar;
+	}
+};
 
-	const double ** tmp_input = d->aeffect->numInputs > 0 ? new const double * [d->aeffect->numInputs] : 0;
-	double ** tmp_output = d->aeffect->numOutputs > 0 ? new double * [d->aeffect->numOutputs] : 0;
-	for (int offset = 0; offset < count; offset += d->blocksize)
+struct QVstChain::Data
+{
+	bool compensate;
+	int trim;
+	bool skipsilence;
+	int defaulttail;
+	bool mixed;
+	bool doubleprecision;
+	bool dither;
+	bool ftz;
+	bool deadlines;
+	double budget;
+	bool fixedblock;
+	int fifofill; // owned by process()
+	PlanarScratch<float> ffifo; // allocated at resume
+	PlanarScratch<double> dfifo;
+	qint64 blocks; // owned by process()
+	QElapsedTimer timer; // the current process() call, deadline monitor only
+	ChainPlan * timed; // plan the current process() call ran, 0 - none yet
+	qint64 timedframes; // frames the current process() call ran
+	QAtomicInteger<qint64> overruns;
+	EventQueue<QVstChain::Overrun, 256> events;
+	quint32 ditherstate; // owned by process()
+	ChainPlan * plan; // owned by process()
+	QAtomicPointer<ChainPlan> pending;
+	QAtomicPointer<ChainPlan> retired;
+	Data(): compensate(false), trim(-1), skipsilence(false), defaulttail(-1), mixed(false), doubleprecision(false), dither(false), ftz(false), deadlines(false), budget(1.0), fixedblock(false), fifofill(0), blocks(0), timed(0), timedframes(0), overruns(0), ditherstate(0x9e3779b9u), plan(0), pending(0), retired(0)
+	{
+	}
+	~Data()
 	{
-		for (int i = 0; i < d->aeffect->numInputs; i++)
+		delete plan;
+		delete pending.fetchAndStoreAcquire(0);
+		reclaim();
+	}
+	Data & operator = (const Data & o)
+	{
+		compensate = o.compensate;
+		trim = -1;
+		skipsilence = o.skipsilence;
+		defaulttail = o.defaulttail;
+		mixed = o.mixed;
+		doubleprecision = o.doubleprecision;
+		dither = o.dither;
+		ftz = o.ftz;
+		deadlines = o.deadlines;
+		budget = o.budget;
+		fixedblock = o.fixedblock;
+		return * this;
+	}
+	ChainPlan * acquire()
+	{
+		ChainPlan * p = pending.fetchAndStoreAcquire(0);
+		if (p)
 		{
-			tmp_input[i] = input[i] + offset;
+			if (plan)
+			{
+				do
+				{
+					plan->next = retired.loadAcquire();
+				}
+				while (!retired.testAndSetRelease(plan->next, plan));
+			}
+			plan = p;
 		}
-		for (int i = 0; i < d->aeffect->numOutputs; i++)
+		return plan;
+	}
+	PlanarScratch<float> & fifo(float)
+	{
+		return ffifo;
+	}
+	PlanarScratch<double> & fifo(double)
+	{
+		return dfifo;
+	}
+	int fifoDelay(int block) const // fixedblock as allocated at resume, for the plan's block
+	{
+		return (fixedblock && block > 0 && (ffifo.block == block || dfifo.block == block)) ? block : 0;
+	}
+	void reclaim()
+	{
+		ChainPlan * p = retired.fetchAndStoreAcquire(0);
+		while (p)
 		{
-			tmp_output[i] = output[i] + offset;
+			ChainPlan * next = p->next;
+			delete p;
+			p = next;
 		}
-		d->aeffect->processDoubleReplacing(d->aeffect, (double **)tmp_input, tmp_output, qMin(d->blocksize, count - offset));
 	}
-	if (d->aeffect->numInputs)
+	void checkDeadline(ChainPlan * p, qint64 elapsed, int count)
 	{
-		delete [] tmp_input;
+		const qint64 block = blocks++;
+		const float rate = p->stages.isEmpty() ? 0.0f : p->stages.front().vst.sampleRate();
+		const qint64 limit = (rate > 0) ? (qint64)(budget * count * 1e9 / rate) : 0;
+		if (limit <= 0 || elapsed <= limit)
+		{
+			return;
+		}
+		QVstChain::Overrun o;
+		o.block = block;
+		o.frames = count;
+		o.elapsed = elapsed;
+		o.budget = limit;
+		o.stage = -1;
+		o.stageElapsed = 0;
+		for (int k = 0; k < p->stages.count(); k++)
+		{
+			if (p->stages[k].elapsed > o.stageElapsed)
+			{
+				o.stage = k;
+				o.stageElapsed = p->stages[k].elapsed;
+			}
+		}
+		overruns.store(overruns.load() + 1);
+		events.push(o);
 	}
-	if (d->aeffect->numOutputs)
+	// times one public process() call however many times it runs the plan
+	struct Deadline
 	{
-		delete [] tmp_output;
-	}
-	return true;
-}
+		Data * d;
+		Deadline(Data * o): d(o)
+		{
+			if (d->deadlines)
+			{
+				d->timed = 0;
+				d->timedframes = 0;
+				d->timer.start();
+			}
+		}
+		~Deadline()
+		{
+			if (d->deadlines && d->timed)
+			{
+				d->checkDeadline(d->timed, d->timer.nsecsElapsed(), (int)d->timedframes);
+			}
+		}
+	};
+	template <class P>
+	void processStage(ChainPlan * p, ChainStage & s, ChainSignal & sig, int count, P * const * direct, int directs);
+	template <class T>
+	void run(ChainPlan * p, const T * const * in, T * const * out, int channels, int count);
+	template <class T>
+	void runStages(ChainPlan * p, const T * const * in, T * const * out, int channels, int count);
+	template <class T>
+	bool process(const T * const * in, T * const * out, int channels, int count);
+	template <class T>
+	bool processInterleaved(const T * in, T * out, int channels, int count);
+	template <class T>
+	bool process(const QVstAudioBuffer<T> & in, QVstAudioBuffer<T> & out);
+	template <class T>
+	bool processOne(const QVector<T> & in, QVector<T> & out);
+	bool processPcm(const void * in, PcmFormat in_format, void * out, PcmFormat out_format, int channels, int count);
+	template <class T>
+	QList< QVector<T> > process(const QList< QVector<T> > & in);
+private:
+	Data(const Data &);
+};
 
-QList< QVector<float> > QVstPlugin::process(const QList< QVector<float> > & in)
+template <class P>
+void QVstChain::Data::processStage(ChainPlan * p, ChainStage & s, ChainSignal & sig, int count, P * const * direct, int directs)
 {
-	QList< QVector<float> > out;
-	if (in.count() != d->aeffect->numInputs || !canProcessFloat())
+	StageBuffers<P> & b = s.buffers(P());
+	for (int k = 0; k < s.inputs; k++)
 	{
-		return out;
+		P * cvt = b.cvt.data() + k * p->block;
+		if (sig.channels == 0)
+		{
+			b.in[k] = p->zero(P());
+		}
+		else if (s.routes.isEmpty())
+		{
+			b.in[k] = fromSignal(sig, qMin(k, sig.channels - 1), cvt, count);
+		}
+		else if (s.routes[k].source >= 0)
+		{
+			const int i = s.routes[k].source;
+			b.in[k] = (i < sig.channels) ? fromSignal(sig, i, cvt, count) : p->zero(P());
+		}
+		else if (s.routes[k].source == ChainRoute::Mix)
+		{
+			const ChainRoute & r = s.routes[k];
+			P * mix = b.mix.data() + k * p->block;
+			bool empty = true;
+			for (int n = 0; n < r.sources.count(); n++)
+			{
+				if (r.sources[n] >= sig.channels)
+				{
+					continue;
+				}
+				const P * source = fromSignal(sig, r.sources[n], cvt, count);
+				if (empty)
+				{
+					QVstSimd::scale(source, mix, r.gains[n], count);
+				}
+				else
+				{
+					QVstSimd::mix(source, mix, r.gains[n], count);
+				}
+				empty = false;
+			}
+			if (empty)
+			{
+				memset(mix, 0, count * sizeof(P));
+			}
+			b.in[k] = mix;
+		}
+		else
+		{
+			b.in[k] = p->zero(P());
+		}
 	}
-	const float ** inputs = d->aeffect->numInputs > 0 ? new const float * [d->aeffect->numInputs] : 0;
-	float ** outputs = d->aeffect->numOutputs > 0 ? new float * [d->aeffect->numOutputs] : 0;
-	int count = 0;
-	for (int i = 0; i < d->aeffect->numInputs; i++)
+	QVstPlugin::Data * v = s.vst.d;
+	if (v->bypassed())
 	{
-		inputs[i] = (float *)in[i].data();
-		if (count == 0 || in[i].count() < count)
+		v->bypassMix(b.in.constData(), s.inputs, b.wetptr.constData(), b.dryptr.constData(), b.out.data(), s.outputs, count);
+	}
+	else if (skipsilence && s.inputs > 0 && v->skipSilence(isSilent(b.in.constData(), s.inputs, count), count, defaulttail))
+	{
+		for (int k = 0; k < s.outputs; k++)
 		{
-			count = in[i].count();
+			b.out[k] = p->zero(P());
 		}
 	}
-	if (d->aeffect->numInputs == 0)
+	else
 	{
-		count = d->blocksize;
+		for (int k = 0; k < s.outputs; k++)
+		{
+			b.target[k] = (direct && k < directs && !b.in.contains(direct[k])) ? direct[k] : b.wetptr[k];
+		}
+		s.vst.process(b.in.data(), b.target.data(), count);
+		v->bypassMix(b.in.constData(), s.inputs, b.target.constData(), b.dryptr.constData(), b.out.data(), s.outputs, count);
 	}
-	if (count > 0)
+	sig.set(b.out.constData(), s.outputs);
+}
+
+// with fixedblock whole plan blocks through the fifo: the output lags the input by one block
+template <class T>
+void QVstChain::Data::run(ChainPlan * p, const T * const * in, T * const * out, int channels, int count)
+{
+	if (deadlines)
 	{
-		for (int i = 0; i < d->aeffect->numOutputs; i++)
+		if (timed != p)
 		{
-			out << QVector<float>(count);
-			outputs[i] = (float *)out[i].data();
+			for (int k = 0; k < p->stages.count(); k++)
+			{
+				p->stages[k].elapsed = 0;
+			}
+			timed = p;
 		}
-		process(inputs, outputs, count);
+		timedframes += count;
 	}
-	if (d->aeffect->numInputs)
+	PlanarScratch<T> & f = fifo(T());
+	if (!fixedblock || f.block != p->block || channels > f.inptr.count())
 	{
-		delete [] inputs;
+		runStages(p, in, out, channels, count);
+		return;
 	}
-	if (d->aeffect->numOutputs)
+	for (int done = 0; done < count; )
 	{
-		delete [] outputs;
+		const int n = qMin(count - done, f.block - fifofill);
+		for (int k = 0; k < channels; k++)
+		{
+			if (!p->generator)
+			{
+				memcpy(f.inptr[k] + fifofill, in[k] + done, n * sizeof(T));
+			}
+			memcpy(out[k] + done, f.outptr[k] + fifofill, n * sizeof(T));
+		}
+		fifofill += n;
+		done += n;
+		if (fifofill == f.block)
+		{
+			runStages(p, (const T * const *)f.inptr.constData(), f.outptr.constData(), channels, f.block);
+			fifofill = 0;
+		}
 	}
-	return out;
 }
 
-QList< QVector<double> > QVstPlugin::process(const QList< QVector<double> > & in)
+template <class T>
+void QVstChain::Data::runStages(ChainPlan * p, const T * const * in, T * const * out, int channels, int count)
 {
-	QList< QVector<double> > out;
-	if (in.count() != d->aeffect->numInputs || !canProcessDouble())
-	{
-		return out;
-	}
-	const double ** inputs = d->aeffect->numInputs > 0 ? new const double * [d->aeffect->numInputs] : 0;
-	double ** outputs = d->aeffect->numOutputs > 0 ? new double * [d->aeffect->numOutputs] : 0;
-	int count = 0;
-	for (int i = 0; i < d->aeffect->numInputs; i++)
+	QVstDenormalGuard guard(ftz);
+	QVstTrace::Scope trace("chain", "process", 0, count);
+	const T ** src = p->inputs(T());
+	T ** dst = p->outputs(T());
+	for (int offset = 0; offset < count; offset += p->block)
 	{
-		inputs[i] = (double *)in[i].data();
-		if (count == 0 || in[i].count() < count)
+		const int n = qMin(p->block, count - offset);
+		for (int k = 0; k < channels; k++)
 		{
-			count = in[i].count();
+			src[k] = p->generator ? p->zero(T()) : in[k] + offset;
+			dst[k] = out[k] + offset;
+		}
+		ChainSignal sig;
+		sig.set(src, p->generator ? 0 : channels);
+		for (int k = 0; k < p->stages.count(); k++)
+		{
+			ChainStage & s = p->stages[k];
+			const int directs = (k == p->stages.count() - 1) ? channels : 0;
+			const qint64 start = deadlines ? timer.nsecsElapsed() : 0;
+			QVstAudit::Scope audit("QVstChain::process", false, k);
+			if (p->mixed ? s.doubles : isDouble(T()))
+			{
+				processStage(p, s, sig, n, directOutput(dst, double()), directs);
+			}
+			else
+			{
+				processStage(p, s, sig, n, directOutput(dst, float()), directs);
+			}
+			if (deadlines)
+			{
+				s.elapsed += timer.nsecsElapsed() - start;
+			}
+		}
+		for (int k = 0; k < channels; k++)
+		{
+			if (sig.channels == 0)
+			{
+				memset(dst[k], 0, n * sizeof(T));
+			}
+			else
+			{
+				toOutput(sig, qMin(k, sig.channels - 1), dst[k], n);
+			}
 		}
 	}
-	if (d->aeffect->numInputs == 0)
+}
+
+template <class T>
+bool QVstChain::Data::process(const T * const * in, T * const * out, int channels, int count)
+{
+	ChainPlan * p = acquire();
+	if (!p || !p->supports(T()) || channels < 1 || channels > p->links)
 	{
-		count = d->blocksize;
+		return false;
 	}
-	if (count > 0)
+	run(p, in, out, channels, count);
+	return true;
+}
+
+template <class T>
+bool QVstChain::Data::processInterleaved(const T * in, T * out, int channels, int count)
+{
+	ChainPlan * p = acquire();
+	if (!p || !p->supports(T()) || channels < 1 || channels > p->links)
 	{
-		for (int i = 0; i < d->aeffect->numOutputs; i++)
+		return false;
+	}
+	PlanarScratch<T> & s = p->planar(T());
+	for (int offset = 0; offset < count; offset += s.block)
+	{
+		const int n = qMin(s.block, count - offset);
+		if (!p->generator)
 		{
-			out << QVector<double>(count);
-			outputs[i] = (double *)out[i].data();
+			QVstSimd::deinterleave(in + offset * channels, s.inptr.constData(), channels, n);
 		}
-		process(inputs, outputs, count);
+		run(p, s.inptr.constData(), s.outptr.constData(), channels, n);
+		QVstSimd::interleave(s.outptr.constData(), out + offset * channels, channels, n);
+	}
+	return true;
+}
+
+template <class T>
+bool QVstChain::Data::process(const QVstAudioBuffer<T> & in, QVstAudioBuffer<T> & out)
+{
+	ChainPlan * p = acquire();
+	const int channels = out.channels();
+	if (!p || !p->supports(T()) || channels < 1 || channels > p->links)
+	{
+		return false;
 	}
-	if (d->aeffect->numInputs)
+	if (!p->generator && (in.channels() != channels || in.frames() < out.frames()))
 	{
-		delete [] inputs;
+		return false;
 	}
-	if (d->aeffect->numOutputs)
+	QVarLengthArray<const T *, 16> src(channels);
+	QVarLengthArray<T *, 16> dst(channels);
+	for (int k = 0; k < channels; k++)
 	{
-		delete [] outputs;
+		src[k] = p->generator ? 0 : in.channel(k);
+		dst[k] = out.channel(k);
 	}
-	return out;
+	run(p, src.constData(), dst.constData(), channels, out.frames());
+	return true;
 }
 
-QVector<float> QVstPlugin::processOne(const QVector<float> & in)
+template <class T>
+bool QVstChain::Data::processOne(const QVector<T> & in, QVector<T> & out)
 {
-	QList< QVector<float> > in_list;
-	for (int i = 0; i < d->aeffect->numInputs; i++)
+	ChainPlan * p = acquire();
+	if (!p || !p->supports(T()) || !p->canProcess(1) || p->stages.isEmpty())
 	{
-		in_list << in;
+		return false;
 	}
-	const QList< QVector<float> > & out_list = process(in_list);
-	if (out_list.isEmpty())
+	const int count = p->generator ? p->stages.front().vst.blockSize() : in.count();
+	out.resize(count);
+	const T * src = in.constData();
+	T * dst = out.data();
+	run(p, & src, & dst, 1, count);
+	if (compensate)
 	{
-		return QVector<float>();
+		if (trim < 0)
+		{
+			trim = p->latency() + fifoDelay(p->block);
+		}
+		trimLatency(out, trim);
 	}
-	return out_list.front();
+	return true;
 }
 
-QVector<double> QVstPlugin::processOne(const QVector<double> & in)
+static int pcmBytes(QVstChain::PcmFormat format)
 {
-	QList< QVector<double> > in_list;
-	for (int i = 0; i < d->aeffect->numInputs; i++)
+	switch (format)
+	{
+	case QVstChain::Int16:
+		return 2;
+	case QVstChain::Int24:
+		return 3;
+	case QVstChain::Int32:
+		return 4;
+	}
+	return 0;
+}
+
+bool QVstChain::Data::processPcm(const void * in, PcmFormat in_format, void * out, PcmFormat out_format, int channels, int count)
+{
+	ChainPlan * p = acquire();
+	if (!p || !p->floats || channels < 1 || channels > p->links)
 	{
-		in_list << in;
+		return false;
 	}
-	const QList< QVector<double> > & out_list = process(in_list);
-	if (out_list.isEmpty())
+	PlanarScratch<float> & s = p->fplanar;
+	const int in_frame = channels * pcmBytes(in_format);
+	const int out_frame = channels * pcmBytes(out_format);
+	quint32 * seed = dither ? & ditherstate : 0;
+	for (int offset = 0; offset < count; offset += s.block)
 	{
-		return QVector<double>();
+		const int n = qMin(s.block, count - offset);
+		const char * src = (const char *)in + offset * in_frame;
+		char * dst = (char *)out + offset * out_frame;
+		if (!p->generator)
+		{
+			switch (in_format)
+			{
+			case Int16:
+				QVstSimd::fromInt16((const qint16 *)src, s.inptr.constData(), channels, n);
+				break;
+			case Int24:
+				QVstSimd::fromInt24((const quint8 *)src, s.inptr.constData(), channels, n);
+				break;
+			case Int32:
+				QVstSimd::fromInt32((const qint32 *)src, s.inptr.constData(), channels, n);
+				break;
+			}
+		}
+		run(p, s.inptr.constData(), s.outptr.constData(), channels, n);
+		switch (out_format)
+		{
+		case Int16:
+			QVstSimd::toInt16(s.outptr.constData(), (qint16 *)dst, channels, n, seed);
+			break;
+		case Int24:
+			QVstSimd::toInt24(s.outptr.constData(), (quint8 *)dst, channels, n, seed);
+			break;
+		case Int32:
+			QVstSimd::toInt32(s.outptr.constData(), (qint32 *)dst, channels, n, seed);
+			break;
+		}
 	}
-	return out_list.front();
+	return true;
 }
 
-// ---------------------------------------------------------------------------------
-
-
-struct QVstChain::Data
+template <class T>
+QList< QVector<T> > QVstChain::Data::process(const QList< QVector<T> > & in)
 {
-	Data()
+	QList< QVector<T> > out;
+	ChainPlan * p = acquire();
+	if (!p || !p->supports(T()) || !p->canProcess(in.count()) || p->stages.isEmpty())
 	{
+		return out;
 	}
-	~Data()
+	const int channels = in.isEmpty() ? p->links : in.count();
+	int count = in.isEmpty() ? p->stages.front().vst.blockSize() : 0;
+	QVector<const T *> inputs(in.count());
+	for (int i = 0; i < in.count(); i++)
 	{
+		inputs[i] = in[i].constData();
+		if (i == 0 || in[i].count() < count)
+		{
+			count = in[i].count();
+		}
 	}
-};
+	QVector<T *> outputs(channels);
+	for (int i = 0; i < channels; i++)
+	{
+		out << QVector<T>(count);
+		outputs[i] = out[i].data();
+	}
+	if (count > 0 && !process(inputs.constData(), outputs.constData(), channels, count))
+	{
+		return QList< QVector<T> >();
+	}
+	if (compensate)
+	{
+		if (trim < 0)
+		{
+			trim = p->latency() + fifoDelay(p->block);
+		}
+		trimLatency(out, trim);
+	}
+	return out;
+}
 
 QVstChain::QVstChain(): QList<QVstPlugin>(), d(new Data())
 {
@@ -831,23 +2636,52 @@ QVstChain::QVstChain(const QStringList & names): QList<QVstPlugin>(), d(new Data
 QVstChain::QVstChain(const QVstChain & o): QList<QVstPlugin>(o), d(new Data())
 {
 	* d = * o.d;
+	publish();
 }
 
 QVstChain & QVstChain::operator = (const QVstChain & o)
 {
 	if (& o != this)
 	{
+		QList<QVstPlugin>::operator = (o);
 		* d = * o.d;
+		publish();
 	}
 	return * this;
 }
 
+#ifdef Q_COMPILER_RVALUE_REFS
+QVstChain::QVstChain(QVstChain && o): QList<QVstPlugin>(), d(o.d)
+{
+	QList<QVstPlugin>::swap(o);
+	o.d = new Data();
+}
+
+QVstChain & QVstChain::operator = (QVstChain && o)
+{
+	QList<QVstPlugin>::swap(o);
+	qSwap(d, o.d);
+	return * this;
+}
+#endif
+
 QVstChain::~QVstChain()
 {
-	unload();
 	delete d;
 }
 
+QVstChain QVstChain::clone() const
+{
+	QVstChain chain;
+	foreach (const QVstPlugin & vst, * this)
+	{
+		chain.append(vst.clone());
+	}
+	* chain.d = * d;
+	chain.publish();
+	return chain;
+}
+
 bool QVstChain::load(const QString & name)
 {
 	return load(QStringList() << name);
@@ -862,10 +2696,12 @@ bool QVstChain::load(const QStringList & names)
 		if (!vst.load(name))
 		{
 			clear();
+			publish();
 			return false;
 		}
 		append(vst);
 	}
+	publish();
 	return true;
 }
 
@@ -885,8 +2721,16 @@ void QVstChain::resume()
 {
 	for (QVstChain::iterator i = begin(); i != end(); i++)
 	{
+		i->setDoublePrecision(d->mixed || d->doubleprecision);
 		i->resume();
 	}
+	d->trim = -1;
+	const int block = blockSize();
+	const int links = linksCount();
+	d->ffifo.allocate(links, links, d->fixedblock && canProcessFloat() ? block : 0);
+	d->dfifo.allocate(links, links, d->fixedblock && canProcessDouble() ? block : 0);
+	d->fifofill = 0;
+	publish();
 }
 
 void QVstChain::suspend()
@@ -905,6 +2749,34 @@ void QVstChain::setBypass(bool b)
 	}
 }
 
+void QVstChain::setHostBypass(bool b)
+{
+	for (QVstChain::iterator i = begin(); i != end(); i++)
+	{
+		i->setHostBypass(b);
+	}
+}
+
+void QVstChain::setFixedBlock(bool state)
+{
+	d->fixedblock = state;
+}
+
+bool QVstChain::fixedBlock() const
+{
+	return d->fixedblock;
+}
+
+int QVstChain::blockSize() const
+{
+	int block = 1;
+	foreach (const QVstPlugin & vst, * this)
+	{
+		block = qMax(block, vst.blockSize());
+	}
+	return block;
+}
+
 void QVstChain::setSampleRate(float sr)
 {
 	for (QVstChain::iterator i = begin(); i != end(); i++)
@@ -921,6 +2793,196 @@ void QVstChain::setBlockSize(int sz)
 	}
 }
 
+int QVstChain::latency() const
+{
+	int latency = 0;
+	foreach (const QVstPlugin & vst, * this)
+	{
+		latency += vst.latency();
+	}
+	return latency + d->fifoDelay(blockSize());
+}
+
+void QVstChain::setLatencyCompensation(bool state)
+{
+	d->compensate = state;
+	d->trim = -1;
+}
+
+bool QVstChain::latencyCompensation() const
+{
+	return d->compensate;
+}
+
+void QVstChain::setSilenceSkipping(bool state, int default_tail)
+{
+	d->skipsilence = state;
+	d->defaulttail = default_tail;
+	for (QVstChain::iterator i = begin(); i != end(); i++)
+	{
+		i->d->silence = 0;
+		i->d->skipping = false;
+	}
+}
+
+bool QVstChain::silenceSkipping() const
+{
+	return d->skipsilence;
+}
+
+void QVstChain::setMixedPrecision(bool state)
+{
+	d->mixed = state;
+	publish();
+}
+
+bool QVstChain::mixedPrecision() const
+{
+	return d->mixed;
+}
+
+void QVstChain::setDoublePrecision(bool state)
+{
+	d->doubleprecision = state;
+}
+
+bool QVstChain::doublePrecision() const
+{
+	return d->doubleprecision;
+}
+
+void QVstChain::setRouting(int index, const QList< QVector<float> > & matrix)
+{
+	if (index < 0 || index >= count())
+	{
+		return;
+	}
+	(* this)[index].d->routing = matrix;
+	publish();
+}
+
+QList< QVector<float> > QVstChain::routing(int index) const
+{
+	if (index < 0 || index >= count())
+	{
+		return QList< QVector<float> >();
+	}
+	return at(index).d->routing;
+}
+
+void QVstChain::setDither(bool state)
+{
+	d->dither = state;
+}
+
+bool QVstChain::dither() const
+{
+	return d->dither;
+}
+
+void QVstChain::setFlushDenormals(bool state)
+{
+	d->ftz = state;
+}
+
+bool QVstChain::flushDenormals() const
+{
+	return d->ftz;
+}
+
+void QVstChain::setDenormalDetection(bool state)
+{
+	for (QVstChain::iterator i = begin(); i != end(); i++)
+	{
+		i->setDenormalDetection(state);
+	}
+}
+
+QList<qint64> QVstChain::denormalsCounts() const
+{
+	QList<qint64> counts;
+	foreach (const QVstPlugin & vst, * this)
+	{
+		counts << vst.denormalsCount();
+	}
+	return counts;
+}
+
+void QVstChain::setProfiling(bool state)
+{
+	for (QVstChain::iterator i = begin(); i != end(); i++)
+	{
+		i->setProfiling(state);
+	}
+}
+
+QList<QVstPlugin::ProcessStats> QVstChain::processStats() const
+{
+	QList<QVstPlugin::ProcessStats> stats;
+	foreach (const QVstPlugin & vst, * this)
+	{
+		stats << vst.processStats();
+	}
+	return stats;
+}
+
+QVstPlugin::ProcessStats QVstChain::totalProcessStats() const
+{
+	QVstPlugin::ProcessStats total;
+	foreach (const QVstPlugin & vst, * this)
+	{
+		total += vst.processStats();
+	}
+	return total;
+}
+
+void QVstChain::resetProcessStats()
+{
+	for (QVstChain::iterator i = begin(); i != end(); i++)
+	{
+		i->resetProcessStats();
+	}
+}
+
+void QVstChain::setDeadlineMonitor(bool state, double budget)
+{
+	d->budget = budget;
+	d->deadlines = state;
+}
+
+bool QVstChain::deadlineMonitor() const
+{
+	return d->deadlines;
+}
+
+qint64 QVstChain::overrunsCount() const
+{
+	return d->overruns.load();
+}
+
+bool QVstChain::takeOverrun(Overrun & o)
+{
+	return d->events.pop(o);
+}
+
+bool QVstChain::setSpeakerArrangement(VstSpeakerArrangementType type)
+{
+	bool accepted = !isEmpty();
+	for (QVstChain::iterator i = begin(); i != end(); i++)
+	{
+		if (!i->isGenerator())
+		{
+			accepted = i->setSpeakerArrangement(type, type) && accepted;
+		}
+		else
+		{
+			accepted = i->setSpeakerArrangement(kSpeakerArrEmpty, type) && accepted;
+		}
+	}
+	publish();
+	return accepted;
+}
+
 QWidgetList QVstChain::editWidgets() const
 {
 	QWidgetList w;
@@ -967,8 +3029,15 @@ int QVstChain::outputsCount() const
 	return count;
 }
 
-void QVstChain::savePreset(const QString & name)
+bool QVstChain::savePreset(const QString & name)
 {
+	foreach (const QVstPlugin & vst, * this)
+	{
+		if (vst.vstFileName().isEmpty())
+		{
+			return false;
+		}
+	}
 	QSettings s(name, QSettings::IniFormat);
 	s.clear();
 	int k = 0;
@@ -983,6 +3052,7 @@ void QVstChain::savePreset(const QString & name)
 	{
 		vst.savePreset(s);
 	}
+	return true;
 }
 
 bool QVstChain::loadPreset(const QString & name)
@@ -996,6 +3066,7 @@ bool QVstChain::loadPreset(const QString & name)
 		if (!vst.load(s.value(key).toString()))
 		{
 			s.endGroup();
+			publish();
 			return false;
 		}
 		vst.d->chainindex = key.toInt();
@@ -1007,6 +3078,7 @@ bool QVstChain::loadPreset(const QString & name)
 	}
 	s.endGroup();
 
+	publish();
 	for (QVstChain::iterator i = begin(); i != end(); i++)
 	{
 		if (!i->loadPreset(s))
@@ -1017,6 +3089,134 @@ bool QVstChain::loadPreset(const QString & name)
 	return true;
 }
 
+void QVstChain::publish()
+{
+	ChainPlan * p = new ChainPlan();
+	p->floats = canProcessFloat();
+	p->doubles = canProcessDouble();
+	p->mixed = d->mixed;
+	p->generator = isGenerator();
+	p->links = linksCount();
+	p->block = blockSize();
+	p->stages.resize(count());
+	for (int k = 0; k < count(); k++)
+	{
+		ChainStage & s = p->stages[k];
+		s.vst = at(k);
+		s.inputs = s.vst.inputsCount();
+		s.outputs = s.vst.outputsCount();
+		s.doubles = s.vst.canProcessDouble();
+		s.route(s.vst.d->routing);
+		if (s.vst.canProcessFloat() && !(p->mixed && s.doubles))
+		{
+			s.f.allocate(s.inputs, s.outputs, p->block);
+			s.f.mix = QVector<float>(s.mixes ? s.inputs * p->block : 0);
+		}
+		if (s.doubles)
+		{
+			s.d.allocate(s.inputs, s.outputs, p->block);
+			s.d.mix = QVector<double>(s.mixes ? s.inputs * p->block : 0);
+		}
+	}
+	p->fzero = QVector<float>(p->block, 0);
+	p->dzero = QVector<double>(p->block, 0);
+	p->fin = QVector<const float *>(p->links);
+	p->fout = QVector<float *>(p->links);
+	p->din = QVector<const double *>(p->links);
+	p->dout = QVector<double *>(p->links);
+	if (p->floats)
+	{
+		p->fplanar.allocate(p->links, p->links, p->block);
+	}
+	if (p->doubles)
+	{
+		p->dplanar.allocate(p->links, p->links, p->block);
+	}
+	delete d->pending.fetchAndStoreOrdered(p);
+	d->reclaim();
+}
+
+void QVstChain::reclaim()
+{
+	d->reclaim();
+}
+
+void QVstChain::publishOnce()
+{
+	if (!d->plan && !d->pending.loadAcquire())
+	{
+		publish();
+	}
+}
+
+// a neighbour's per plugin settings, precision as QVstChain::resume() sets it
+static void prepareLike(QVstPlugin & vst, const QVstPlugin & o, bool doubles)
+{
+	vst.setSampleRate(o.sampleRate());
+	vst.setBlockSize(o.blockSize());
+	vst.setFixedBlock(o.fixedBlock());
+	vst.setDoublePrecision(doubles);
+	vst.setFlushDenormals(o.flushDenormals());
+	vst.setDenormalDetection(o.denormalDetection());
+	vst.setBypassCrossfade(o.bypassCrossfade());
+	vst.setProfiling(o.profiling());
+	if (!o.isSuspended())
+	{
+		vst.resume();
+	}
+}
+
+bool QVstChain::hotReplace(int index, const QString & name, const QString & preset)
+{
+	return hotReplace(index, QVstPlugin(name, preset));
+}
+
+bool QVstChain::hotReplace(int index, QVstPlugin vst)
+{
+	if (index < 0 || index >= count() || !vst.isLoaded())
+	{
+		return false;
+	}
+	prepareLike(vst, at(index), d->mixed || d->doubleprecision);
+	vst.d->chainindex = index;
+	vst.d->routing = at(index).d->routing;
+	replace(index, vst);
+	publish();
+	return true;
+}
+
+bool QVstChain::hotInsert(int index, const QString & name, const QString & preset)
+{
+	return hotInsert(index, QVstPlugin(name, preset));
+}
+
+bool QVstChain::hotInsert(int index, QVstPlugin vst)
+{
+	if (index < 0 || index > count() || !vst.isLoaded())
+	{
+		return false;
+	}
+	if (!isEmpty())
+	{
+		prepareLike(vst, at(qMin(index, count() - 1)), d->mixed || d->doubleprecision);
+	}
+	vst.d->chainindex = index;
+	insert(index, vst);
+	publish();
+	return true;
+}
+
+bool QVstChain::hotRemove(int index)
+{
+	if (index < 0 || index >= count())
+	{
+		return false;
+	}
+	removeAt(index);
+	publish();
+	return true;
+}
+
 bool QVstChain::canProcessFloat() const
 {
 	if (isEmpty())
@@ -1025,7 +3225,7 @@ bool QVstChain::canProcessFloat() const
 	}
 	foreach(const QVstPlugin & vst, * this)
 	{
-		if (!vst.canProcessFloat())
+		if (!vst.canProcessFloat() && !(d->mixed && vst.canProcessDouble()))
 		{
 			return false;
 		}
@@ -1041,7 +3241,7 @@ bool QVstChain::canProcessDouble() const
 	}
 	foreach(const QVstPlugin & vst, * this)
 	{
-		if (!vst.canProcessDouble())
+		if (!vst.canProcessDouble() && !(d->mixed && vst.canProcessFloat()))
 		{
 			return false;
 		}
@@ -1094,67 +3294,111 @@ bool QVstChain::canProcess(int i) const
 	return (i <= linksCount());
 }
 
+bool QVstChain::process(const float ** input, float ** output, int channels, int count)
+{
+	QVstAudit::Scope audit("QVstChain::process");
+	publishOnce();
+	Data::Deadline deadline(d);
+	return d->process<float>(input, output, channels, count);
+}
+
+bool QVstChain::process(const double ** input, double ** output, int channels, int count)
+{
+	QVstAudit::Scope audit("QVstChain::process");
+	publishOnce();
+	Data::Deadline deadline(d);
+	return d->process<double>(input, output, channels, count);
+}
+
+bool QVstChain::processInterleaved(const float * input, float * output, int channels, int frames)
+{
+	QVstAudit::Scope audit("QVstChain::process");
+	publishOnce();
+	Data::Deadline deadline(d);
+	return d->processInterleaved(input, output, channels, frames);
+}
+
+bool QVstChain::processInterleaved(const double * input, double * output, int channels, int frames)
+{
+	QVstAudit::Scope audit("QVstChain::process");
+	publishOnce();
+	Data::Deadline deadline(d);
+	return d->processInterleaved(input, output, channels, frames);
+}
+
+bool QVstChain::process(const QVstAudioBuffer<float> & input, QVstAudioBuffer<float> & output)
+{
+	QVstAudit::Scope audit("QVstChain::process");
+	publishOnce();
+	Data::Deadline deadline(d);
+	return d->process(input, output);
+}
+
+bool QVstChain::process(const QVstAudioBuffer<double> & input, QVstAudioBuffer<double> & output)
+{
+	QVstAudit::Scope audit("QVstChain::process");
+	publishOnce();
+	Data::Deadline deadline(d);
+	return d->process(input, output);
+}
+
+bool QVstChain::processPcm(const void * input, PcmFormat input_format, void * output, PcmFormat output_format, int channels, int frames)
+{
+	QVstAudit::Scope audit("QVstChain::process");
+	publishOnce();
+	Data::Deadline deadline(d);
+	return d->processPcm(input, input_format, output, output_format, channels, frames);
+}
+
 QList< QVector<float> > QVstChain::process(const QList< QVector<float> > & in)
 {
-	QList< QVector<float> > out;
-	if (!canProcessFloat())
-	{
-		return out;
-	}
-	if (canProcess(in.count()))
-	{
-		out = in;
-		for (QVstChain::iterator i = begin(); i != end(); i++)
-		{
-			while (out.count() < i->inputsCount())
-			{
-				out.append(out[out.count() - 1]);
-			}
-			out = i->process(out.mid(0, i->inputsCount()));
-		}		
-	}
-	return out.mid(0, in.count());
+	QVstAudit::Scope audit("QVstChain::process");
+	publishOnce();
+	Data::Deadline deadline(d);
+	return d->process(in);
 }
 
 QList< QVector<double> > QVstChain::process(const QList< QVector<double> > & in)
 {
-	QList< QVector<double> > out;
-	if (!canProcessFloat())
-	{
-		return out;
-	}
-	if (canProcess(in.count()))
-	{
-		out = in;
-		for (QVstChain::iterator i = begin(); i != end(); i++)
-		{
-			while (out.count() < i->inputsCount())
-			{
-				out.append(out[out.count() - 1]);
-			}
-			out = i->process(out.mid(0, i->inputsCount()));
-		}		
-	}
-	return out.mid(0, in.count());
+	QVstAudit::Scope audit("QVstChain::process");
+	publishOnce();
+	Data::Deadline deadline(d);
+	return d->process(in);
 }
 
 QVector<float> QVstChain::processOne(const QVector<float> & in)
 {
-	const QList< QVector<float> > & out = process(QList< QVector<float> >() << in);
-	if (out.isEmpty())
+	QVector<float> out;
+	if (!processOne(in, out))
 	{
 		return QVector<float>();
 	}
-	return out.front();
+	return out;
+}
+
+bool QVstChain::processOne(const QVector<float> & in, QVector<float> & out)
+{
+	QVstAudit::Scope audit("QVstChain::process");
+	publishOnce();
+	Data::Deadline deadline(d);
+	return d->processOne(in, out);
 }
 
 QVector<double> QVstChain::processOne(const QVector<double> & in)
 {
-	const QList< QVector<double> > & out = process(QList< QVector<double> >() << in);
-	if (out.isEmpty())
+	QVector<double> out;
+	if (!processOne(in, out))
 	{
 		return QVector<double>();
 	}
-	return out.front();
+	return out;
+}
+
+bool QVstChain::processOne(const QVector<double> & in, QVector<double> & out)
+{
+	QVstAudit::Scope audit("QVstChain::process");
+	publishOnce();
+	Data::Deadline deadline(d);
+	return d->processOne(in, out);
 }
 
@@ -7,6 +7,7 @@
 #include <QVector>
 #include <QSettings>
 #include "./vstsdk/aeffectx.h"
+#include "qvstaudiobuffer.h"
 
 class QVstPlugin
 {
@@ -14,12 +15,23 @@ class QVstPlugin
 	struct Data;
 	Data * d;
 public:
-// ctor
+// ctor, copies share the loaded instance
 	QVstPlugin();
 	QVstPlugin(const QString & name, const QString & preset = QString());
+	explicit QVstPlugin(AEffect *); // adopts an effect built in process, effClose releases it
 	QVstPlugin(const QVstPlugin &);
 	QVstPlugin & operator = (const QVstPlugin &);
-// dtor
+#ifdef Q_COMPILER_RVALUE_REFS
+	QVstPlugin(QVstPlugin &&);
+	QVstPlugin & operator = (QVstPlugin &&);
+#endif
+	QVstPlugin clone() const; // loads a new instance with the same parameters, adopted effects are asked for a copy with CloneEffect
+	enum
+	{
+		CloneEffect = 0x51566c63 // effVendorSpecific index, the effect returns a new AEffect *
+	};
+	bool isShared() const;
+// dtor, the last reference unloads
 	~QVstPlugin();
 
 // loading
@@ -29,6 +41,7 @@ public:
 	bool load();
 	bool unload();
 	bool isLoaded() const;
+	static int loadsCount(); // instances loaded or adopted in this process
 
 // low level
 	const AEffect * lowLevelApi() const;
@@ -39,12 +52,51 @@ public:
 	bool isSuspended() const;
 	void setBypass(bool);
 	bool bypass() const;
+	void setHostBypass(bool); // QVstChain passes the signal around the plugin, delayed by latency()
+	bool hostBypass() const;
+	void setBypassCrossfade(int); // samples, host bypass toggle crossfade
+	int bypassCrossfade() const;
 
 // common pars
 	void setSampleRate(float);
 	float sampleRate() const;
 	void setBlockSize(int);
 	int blockSize() const;
+	void setFixedBlock(bool); // the plugin always gets blockSize() samples through a fifo, adds blockSize() to latency(), applied on resume()
+	bool fixedBlock() const;
+	void setDoublePrecision(bool); // resume() prepares the plugin at 64 bits where it can, else 32 bits unless it only does double
+	bool doublePrecision() const;
+
+// latency
+	int initialDelay() const; // samples, refreshed on resume and audioMasterIOChanged
+	int latency() const; // initialDelay() plus the fixed block fifo
+	int tailSize() const; // effGetTailSize at resume: 0 - unknown, 1 - no tail
+
+// denormals
+	void setFlushDenormals(bool); // FTZ and DAZ while process() runs
+	bool flushDenormals() const;
+	void setDenormalDetection(bool); // counts subnormal output samples, finds plugins that need flushing
+	bool denormalDetection() const;
+	qint64 denormalsCount() const; // readable from any thread
+	void resetDenormalsCount();
+
+// cpu accounting
+	struct ProcessStats
+	{
+		qint64 calls;
+		qint64 samples;
+		qint64 total; // ns inside processReplacing
+		qint64 min;
+		qint64 max;
+		QVector<qint64> histogram; // calls per duration, bucket k counts [2^k, 2^(k+1)) ns
+		ProcessStats();
+		double nsPerSample() const;
+		ProcessStats & operator += (const ProcessStats &);
+	};
+	void setProfiling(bool); // times every processReplacing call, off by default
+	bool profiling() const;
+	ProcessStats processStats() const; // lock free, readable from any thread while processing
+	void resetProcessStats(); // applied at the next processed block
 
 // gui
 	QWidget * editWidget() const;
@@ -62,13 +114,19 @@ public:
 
 // inputs properties
 	int inputsCount() const;
-	QList<VstPinProperties> inputs() const;
+	QList<VstPinProperties> inputs() const; // cached at load, resume and audioMasterIOChanged
 	bool isGenerator() const;
 
 // outputs properties
 	int outputsCount() const;
 	QList<VstPinProperties> outputs() const;
 
+// speaker arrangement
+	bool setSpeakerArrangement(VstSpeakerArrangementType input, VstSpeakerArrangementType output); // true if accepted, suspends the plugin around the change
+	VstSpeakerArrangementType inputArrangement() const; // kSpeakerArrEmpty if unknown
+	VstSpeakerArrangementType outputArrangement() const;
+	static int speakersCount(VstSpeakerArrangementType);
+
 // programs(presets) properties
 	int programsCount() const;
 	void setProgram(int, const QString * new_program_name = NULL);
@@ -92,14 +150,20 @@ public:
 	bool canProcessDouble() const;
 
 // processing
-	bool process(const float **, float **, int);
+	bool process(const float **, float **, int); // runs at the precision prepared by resume(), calls of the other type are converted
 	bool process(const double **, double **, int);
+	bool processInterleaved(const float *, float *, int); // frames of inputsCount() in, outputsCount() out, needs resume()
+	bool processInterleaved(const double *, double *, int);
+	bool process(const QVstAudioBuffer<float> &, QVstAudioBuffer<float> &); // inputsCount() and outputsCount() channels, output frames are processed
+	bool process(const QVstAudioBuffer<double> &, QVstAudioBuffer<double> &);
 
 	QList< QVector<float> > process(const QList< QVector<float> > & in = QList< QVector<float> >());
 	QList< QVector<double> > process(const QList< QVector<double> > & in = QList< QVector<double> >());
 
 	QVector<float> processOne(const QVector<float> & in = QVector<float>());
 	QVector<double> processOne(const QVector<double> & in = QVector<double>());
+	bool processOne(const QVector<float> &, QVector<float> &); // the input feeds every input pin, first output only, out is reused
+	bool processOne(const QVector<double> &, QVector<double> &);
 };
 
 // ---------------------------------------------------------------------------------
@@ -108,13 +172,26 @@ class QVstChain: public QList<QVstPlugin>
 {
 	struct Data;
 	Data * d;
+	void publishOnce(); // chains changed through QList and never resumed get their first plan at the first process()
 public:
-// ctor
+	enum PcmFormat // interleaved integer samples, little endian
+	{
+		Int16,
+		Int24, // packed, 3 bytes per sample
+		Int32
+	};
+
+// ctor, copies share the plugin instances
 	QVstChain();
 	QVstChain(const QString & preset);
 	QVstChain(const QStringList & names);
 	QVstChain(const QVstChain &);
 	QVstChain & operator = (const QVstChain &);
+#ifdef Q_COMPILER_RVALUE_REFS
+	QVstChain(QVstChain &&);
+	QVstChain & operator = (QVstChain &&);
+#endif
+	QVstChain clone() const; // loads new instances of all plugins
 // dtor
 	~QVstChain();
 
@@ -123,14 +200,77 @@ public:
 	bool load(const QStringList &);
 	bool unload();
 
+// hot swap, call from a non realtime thread, process() picks the new chain up at the next block
+	bool hotReplace(int, const QString & name, const QString & preset = QString());
+	bool hotInsert(int, const QString & name, const QString & preset = QString());
+	bool hotReplace(int, QVstPlugin); // a loaded, suspended plugin, takes the neighbour's settings
+	bool hotInsert(int, QVstPlugin);
+	bool hotRemove(int);
+	void publish(); // makes direct QList changes visible to process()
+	void reclaim(); // destroys plugins released by process()
+
 // start/stop
-	void resume();
+	void resume(); // also publish(), so process() doesn't allocate
 	void suspend();
 	void setBypass(bool);
+	void setHostBypass(bool);
 
 // common pars
 	void setSampleRate(float);
 	void setBlockSize(int);
+	int blockSize() const; // the largest plugin block size
+	void setFixedBlock(bool); // process() calls of any length go through one fifo in front of the chain in whole blockSize() blocks, adds blockSize() to latency(), applied on resume()
+	bool fixedBlock() const;
+
+// latency
+	int latency() const; // sum of plugins latencies
+	void setLatencyCompensation(bool); // offline: the QVector process() and processOne() drop the leading latency() samples
+	bool latencyCompensation() const; // fixed size outputs aren't trimmed, callers skip latency() samples as QVstRenderer does
+
+// silence
+	void setSilenceSkipping(bool, int default_tail = -1); // skip a plugin once its input has been silent longer than its tail, default_tail is used for unknown tails (-1 - never skip)
+	bool silenceSkipping() const;
+
+// routing
+	void setRouting(int, const QList< QVector<float> > &); // plugin index, matrix[input pin][previous plugin output or chain input] = gain, empty - pin k takes channel k or the last one
+	QList< QVector<float> > routing(int) const;
+
+// precision
+	void setMixedPrecision(bool); // every plugin runs at its best precision, signal is converted between them
+	bool mixedPrecision() const;
+	void setDoublePrecision(bool); // every plugin's setDoublePrecision() on resume(), double process() calls run without conversion
+	bool doublePrecision() const;
+
+// denormals
+	void setFlushDenormals(bool); // FTZ and DAZ for the whole process() call
+	bool flushDenormals() const;
+	void setDenormalDetection(bool); // on every plugin
+	QList<qint64> denormalsCounts() const; // per plugin
+
+// cpu accounting
+	void setProfiling(bool); // on every plugin
+	QList<QVstPlugin::ProcessStats> processStats() const; // per plugin
+	QVstPlugin::ProcessStats totalProcessStats() const;
+	void resetProcessStats();
+
+// deadlines
+	struct Overrun
+	{
+		qint64 block; // process() call index
+		int frames;
+		qint64 elapsed; // ns
+		qint64 budget; // ns
+		int stage; // plugin index that took the longest, -1 - none
+		qint64 stageElapsed;
+	};
+	void setDeadlineMonitor(bool, double budget = 1.0); // overrun - a process() call longer than budget * frames / sampleRate(), measured once per call whatever the entry point
+	bool deadlineMonitor() const;
+	qint64 overrunsCount() const; // readable from any thread
+	bool takeOverrun(Overrun &); // oldest queued overrun, lock free, one consumer thread, up to 255 are queued
+
+// integer pcm
+	void setDither(bool); // TPDF dither when processPcm() writes integer samples
+	bool dither() const;
 
 // gui
 	QWidgetList editWidgets() const;
@@ -142,8 +282,11 @@ public:
 // outputs properties
 	int outputsCount() const;
 
+// speaker arrangement
+	bool setSpeakerArrangement(VstSpeakerArrangementType); // every plugin in and out, true if all accepted
+
 // programs(presets) properties
-	void savePreset(const QString &); // ini filename
+	bool savePreset(const QString &); // ini filename, false and nothing written if a plugin has no vstFileName() (fan-outs, mocks, adopted effects)
 	bool loadPreset(const QString &); // ini filename
 
 // queries
@@ -153,11 +296,21 @@ public:
 	bool canProcess(int) const;
 
 // processing
+	bool process(const float **, float **, int, int); // channels, samples
+	bool process(const double **, double **, int, int);
+	bool processInterleaved(const float *, float *, int, int); // channels, frames
+	bool processInterleaved(const double *, double *, int, int);
+	bool processPcm(const void *, PcmFormat, void *, PcmFormat, int, int); // converts straight into the first plugin inputs and from the last plugin outputs, channels, frames
+	bool process(const QVstAudioBuffer<float> &, QVstAudioBuffer<float> &); // output channels and frames are processed, input is ignored by generators
+	bool process(const QVstAudioBuffer<double> &, QVstAudioBuffer<double> &);
+
 	QList< QVector<float> > process(const QList< QVector<float> > & in = QList< QVector<float> >());
 	QList< QVector<double> > process(const QList< QVector<double> > & in = QList< QVector<double> >());
 
 	QVector<float> processOne(const QVector<float> & in = QVector<float>());
 	QVector<double> processOne(const QVector<double> & in = QVector<double>());
+	bool processOne(const QVector<float> &, QVector<float> &); // first output only, out is reused, generators make the first plugin's blockSize() samples
+	bool processOne(const QVector<double> &, QVector<double> &);
 };
 
 #endif // QVSTHOST_H
@@ -0,0 +1,237 @@
+#include "qvstmock.h"
+#include <QElapsedTimer>
+#include <string.h>
+
+QVstMock::Config::Config(): inputs(2), outputs(2), parameters(0), programs(1), flags(effFlagsCanReplacing | effFlagsCanDoubleReplacing),
+	latency(0), tail(0), chunk(0), uniqueID(0x51566d6b), gain(1.0f), callCost(0), sampleCost(0.0), name("QVstMock")
+{
+}
+
+struct MockEffect
+{
+	AEffect effect;
+	QVstMock::Config config;
+	QVector<float> params;
+	QVector<double> delays; // outputs * latency
+	int pos;
+	int program;
+	QByteArray chunk;
+	MockEffect(const QVstMock::Config & c): config(c), params(qMax(0, c.parameters)), pos(0), program(0)
+	{
+		memset(& effect, 0, sizeof(effect));
+		reset();
+	}
+	void reset()
+	{
+		delays = QVector<double>(config.outputs * qMax(0, config.latency));
+		delays.fill(0.0);
+		pos = 0;
+	}
+	void spin(int count)
+	{
+		const qint64 ns = config.callCost + (qint64)(config.sampleCost * count);
+		if (ns <= 0)
+		{
+			return;
+		}
+		QElapsedTimer timer;
+		timer.start();
+		while (timer.nsecsElapsed() < ns)
+		{
+		}
+	}
+	VstIntPtr getChunk(void ** ptr)
+	{
+		chunk = QByteArray(config.chunk, 0);
+		const int n = qMin(config.chunk / (int)sizeof(float), params.count());
+		memcpy(chunk.data(), params.constData(), n * sizeof(float));
+		for (int i = n * sizeof(float); i < config.chunk; i++)
+		{
+			chunk.data()[i] = (char)i;
+		}
+		* ptr = chunk.data();
+		return chunk.size();
+	}
+	VstIntPtr setChunk(const void * ptr, VstIntPtr size)
+	{
+		if (!ptr || size != config.chunk)
+		{
+			return 0;
+		}
+		const int n = qMin(config.chunk / (int)sizeof(float), params.count());
+		memcpy(params.data(), ptr, n * sizeof(float));
+		return 1;
+	}
+	template <class T>
+	void process(T ** in, T ** out, int count)
+	{
+		const int latency = qMax(0, config.latency);
+		for (int k = 0; k < config.outputs; k++)
+		{
+			T * o = out[k];
+			if (config.inputs > 0)
+			{
+				const T * i = in[k % config.inputs];
+				for (int n = 0; n < count; n++)
+				{
+					o[n] = i[n] * config.gain;
+				}
+			}
+			else
+			{
+				for (int n = 0; n < count; n++)
+				{
+					o[n] = config.gain;
+				}
+			}
+			if (latency > 0)
+			{
+				double * line = delays.data() + k * latency;
+				int p = pos;
+				for (int n = 0; n < count; n++)
+				{
+					const double y = line[p];
+					line[p] = o[n];
+					o[n] = (T)y;
+					if (++p == latency)
+					{
+						p = 0;
+					}
+				}
+			}
+		}
+		if (latency > 0)
+		{
+			pos = (pos + count) % latency;
+		}
+		spin(count);
+	}
+};
+
+// AEffect callbacks
+extern "C" {
+static VstIntPtr VSTCALLBACK mockDispatcher(AEffect * effect, VstInt32 opcode, VstInt32 index, VstIntPtr value, void * ptr, float)
+{
+	MockEffect * mock = (MockEffect *)effect->object;
+	switch (opcode)
+	{
+	case effClose:
+		delete mock;
+		return 1;
+	case effMainsChanged:
+		if (value)
+		{
+			mock->reset();
+		}
+		return 0;
+	case effSetProgram:
+		if (value >= 0 && value < mock->config.programs)
+		{
+			mock->program = (int)value;
+		}
+		return 0;
+	case effGetProgram:
+		return mock->program;
+	case effGetProgramName:
+	case effGetProgramNameIndexed:
+		vst_strncpy((char *)ptr, "program", kVstMaxProgNameLen);
+		return 1;
+	case effGetParamName:
+		vst_strncpy((char *)ptr, "param", kVstMaxParamStrLen);
+		return 0;
+	case effGetParamDisplay:
+		if (index >= 0 && index < mock->params.count())
+		{
+			qsnprintf((char *)ptr, kVstMaxParamStrLen + 1, "%.3f", mock->params[index]);
+		}
+		return 0;
+	case effGetChunk:
+		return (mock->config.chunk > 0) ? mock->getChunk((void **)ptr) : 0;
+	case effSetChunk:
+		return (mock->config.chunk > 0) ? mock->setChunk(ptr, value) : 0;
+	case effGetEffectName:
+	case effGetProductString:
+		vst_strncpy((char *)ptr, mock->config.name.toLatin1().constData(), kVstMaxEffectNameLen);
+		return 1;
+	case effGetVendorString:
+		vst_strncpy((char *)ptr, "QVstHost", kVstMaxVendorStrLen);
+		return 1;
+	case effGetPlugCategory:
+		return (mock->config.inputs == 0) ? kPlugCategGenerator : kPlugCategEffect;
+	case effGetTailSize:
+		return mock->config.tail;
+	case effGetVstVersion:
+		return kVstVersion;
+	case effSetProcessPrecision:
+		return 1;
+	case effVendorSpecific:
+		if (index == QVstPlugin::CloneEffect)
+		{
+			return (VstIntPtr)QVstMock::createEffect(mock->config);
+		}
+		break;
+	}
+	return 0;
+}
+
+static void VSTCALLBACK mockSetParameter(AEffect * effect, VstInt32 index, float value)
+{
+	MockEffect * mock = (MockEffect *)effect->object;
+	if (index >= 0 && index < mock->params.count())
+	{
+		mock->params[index] = value;
+	}
+}
+
+static float VSTCALLBACK mockGetParameter(AEffect * effect, VstInt32 index)
+{
+	MockEffect * mock = (MockEffect *)effect->object;
+	return (index >= 0 && index < mock->params.count()) ? mock->params[index] : 0.0f;
+}
+
+static void VSTCALLBACK mockProcessReplacing(AEffect * effect, float ** inputs, float ** outputs, VstInt32 samples)
+{
+	((MockEffect *)effect->object)->process(inputs, outputs, samples);
+}
+
+static void VSTCALLBACK mockProcessDoubleReplacing(AEffect * effect, double ** inputs, double ** outputs, VstInt32 samples)
+{
+	((MockEffect *)effect->object)->process(inputs, outputs, samples);
+}
+}
+
+AEffect * QVstMock::createEffect(const Config & config)
+{
+	if (config.inputs < 0 || config.outputs < 0)
+	{
+		return 0;
+	}
+	MockEffect * mock = new MockEffect(config);
+	AEffect & e = mock->effect;
+	e.magic = kEffectMagic;
+	e.dispatcher = mockDispatcher;
+	e.setParameter = mockSetParameter;
+	e.getParameter = mockGetParameter;
+	e.processReplacing = (config.flags & effFlagsCanReplacing) ? mockProcessReplacing : 0;
+	e.processDoubleReplacing = (config.flags & effFlagsCanDoubleReplacing) ? mockProcessDoubleReplacing : 0;
+	e.numPrograms = config.programs;
+	e.numParams = mock->params.count();
+	e.numInputs = config.inputs;
+	e.numOutputs = config.outputs;
+	e.flags = config.flags | ((config.chunk > 0) ? effFlagsProgramChunks : 0);
+	e.initialDelay = config.latency;
+	e.uniqueID = config.uniqueID;
+	e.version = 1;
+	e.object = mock;
+	return & e;
+}
+
+QVstPlugin QVstMock::create(const Config & config)
+{
+	AEffect * e = createEffect(config);
+	if (!e)
+	{
+		return QVstPlugin();
+	}
+	return QVstPlugin(e);
+}
@@ -0,0 +1,33 @@
+#ifndef QVSTMOCK_H
+#define QVSTMOCK_H
+
+#include "qvsthost.h"
+
+// in process effect for benchmarks and stress tests, no library is loaded,
+// output k is input (k % inputs) times gain delayed by latency samples, a constant gain for 0 inputs,
+// the effect clones itself through QVstPlugin::clone()
+class QVstMock
+{
+public:
+	struct Config
+	{
+		int inputs;
+		int outputs;
+		int parameters;
+		int programs;
+		int flags; // effFlags*, effFlagsProgramChunks is set from chunk
+		int latency; // initialDelay, samples
+		int tail; // effGetTailSize
+		int chunk; // effGetChunk bytes (parameters, then filler), 0 - no chunks, effSetChunk accepts this size only
+		int uniqueID;
+		float gain;
+		qint64 callCost; // ns spent in every process call
+		double sampleCost; // ns per sample frame spent in process
+		QString name;
+		Config(); // 2 in, 2 out, replacing and double replacing, no cost
+	};
+	static QVstPlugin create(const Config & = Config());
+	static AEffect * createEffect(const Config & = Config()); // effClose releases it
+};
+
+#endif // QVSTMOCK_H
@@ -0,0 +1,548 @@
+#include "qvstrecorder.h"
+#include <QAtomicInt>
+#include <QFile>
+#include <QDataStream>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QElapsedTimer>
+#include <QVarLengthArray>
+#include <string.h>
+
+enum RecordType
+{
+	RecordDispatch = 1,
+	RecordSetParameter,
+	RecordGetParameter,
+	RecordProcess
+};
+
+static const char record_magic[8] = { 'Q', 'V', 'S', 'T', 'R', 'E', 'C', '1' };
+
+static int arrangementSize(const VstSpeakerArrangement * a)
+{
+	const int extra = qMax(0, a->numChannels - 8);
+	return sizeof(VstSpeakerArrangement) + extra * sizeof(VstSpeakerProperties);
+}
+
+// dispatcher calls whose ptr (and value) the plugin reads, the data is stored with the call
+static QByteArray payload(VstInt32 opcode, VstIntPtr value, void * ptr)
+{
+	if (!ptr)
+	{
+		return QByteArray();
+	}
+	switch (opcode)
+	{
+	case effSetProgramName:
+	case effCanDo:
+	case effString2Parameter:
+		return QByteArray((const char *)ptr, qstrlen((const char *)ptr) + 1);
+	case effSetChunk:
+		return QByteArray((const char *)ptr, (int)value);
+	case effBeginLoadBank:
+	case effBeginLoadProgram:
+		return QByteArray((const char *)ptr, sizeof(VstPatchChunkInfo));
+	case effSetSpeakerArrangement:
+		if (value)
+		{
+			const VstSpeakerArrangement * in = (const VstSpeakerArrangement *)value;
+			const VstSpeakerArrangement * out = (const VstSpeakerArrangement *)ptr;
+			return QByteArray((const char *)in, arrangementSize(in)).append((const char *)out, arrangementSize(out));
+		}
+		break;
+	}
+	return QByteArray();
+}
+
+// host <-> editor or process bound calls that can't be driven from a file
+static bool replayable(VstInt32 opcode)
+{
+	switch (opcode)
+	{
+	case effOpen:
+	case effClose:
+	case effEditGetRect:
+	case effEditOpen:
+	case effEditClose:
+	case effEditIdle:
+	case effProcessEvents:
+	case effVendorSpecific:
+	case effEditKeyDown:
+	case effEditKeyUp:
+		return false;
+	}
+	return true;
+}
+
+struct QVstRecorder::Data
+{
+	enum { Opcodes = 128 }; // larger opcodes are counted in the last one
+	QVstPlugin vst;
+	AEffect * effect; // 0 - detached or closed
+	AEffectDispatcherProc dispatcher;
+	AEffectSetParameterProc setParameter;
+	AEffectGetParameterProc getParameter;
+	AEffectProcessProc processReplacing;
+	AEffectProcessDoubleProc processDoubleReplacing;
+	QAtomicInteger<qint64> opcodes[Opcodes];
+	QAtomicInteger<qint64> sets;
+	QAtomicInteger<qint64> gets;
+	QAtomicInteger<qint64> processes;
+	QAtomicInt recording;
+	bool audio;
+	QMutex lock; // file and stream
+	QFile file;
+	QDataStream stream;
+	QElapsedTimer clock;
+	Data(): effect(0), dispatcher(0), setParameter(0), getParameter(0), processReplacing(0), processDoubleReplacing(0), recording(0), audio(false)
+	{
+	}
+	static Data * of(AEffect * e)
+	{
+		return (Data *)e->resvd1;
+	}
+	void begin(RecordType type)
+	{
+		stream << (quint8)type << (qint64)clock.nsecsElapsed();
+	}
+	void call(AEffect * e, float ** in, float ** out, int count)
+	{
+		processReplacing(e, in, out, count);
+	}
+	void call(AEffect * e, double ** in, double ** out, int count)
+	{
+		processDoubleReplacing(e, in, out, count);
+	}
+	template <class T>
+	void process(AEffect * e, T ** in, T ** out, int count)
+	{
+		const int bytes = count * sizeof(T);
+		quint64 inhash = QVstRecorder::hash(0, 0);
+		QByteArray input;
+		for (int k = 0; k < e->numInputs; k++)
+		{
+			inhash = QVstRecorder::hash(in[k], bytes, inhash);
+			if (audio)
+			{
+				input.append((const char *)in[k], bytes);
+			}
+		}
+		call(e, in, out, count);
+		quint64 outhash = QVstRecorder::hash(0, 0);
+		for (int k = 0; k < e->numOutputs; k++)
+		{
+			outhash = QVstRecorder::hash(out[k], bytes, outhash);
+		}
+		QMutexLocker locker(& lock);
+		if (recording.loadAcquire())
+		{
+			begin(RecordProcess);
+			stream << (quint8)(sizeof(T) * 8) << (qint32)count << inhash << outhash << input;
+		}
+	}
+	void restore()
+	{
+		if (!effect)
+		{
+			return;
+		}
+		effect->dispatcher = dispatcher;
+		effect->setParameter = setParameter;
+		effect->getParameter = getParameter;
+		effect->processReplacing = processReplacing;
+		effect->processDoubleReplacing = processDoubleReplacing;
+		effect->resvd1 = 0;
+		effect = 0;
+	}
+
+// AEffect callbacks
+	static VstIntPtr VSTCALLBACK dispatcherProxy(AEffect * e, VstInt32 opcode, VstInt32 index, VstIntPtr value, void * ptr, float opt)
+	{
+		Data * r = of(e);
+		r->opcodes[qBound(0, (int)opcode, (int)Opcodes - 1)].fetchAndAddRelaxed(1);
+		if (!r->recording.loadAcquire())
+		{
+			const VstIntPtr result = r->dispatcher(e, opcode, index, value, ptr, opt);
+			if (opcode == effClose)
+			{
+				r->effect = 0;
+			}
+			return result;
+		}
+		const QByteArray data = payload(opcode, value, ptr);
+		const VstIntPtr result = r->dispatcher(e, opcode, index, value, ptr, opt);
+		if (opcode == effClose)
+		{
+			r->effect = 0;
+		}
+		QMutexLocker locker(& r->lock);
+		if (r->recording.loadAcquire())
+		{
+			r->begin(RecordDispatch);
+			r->stream << (qint32)opcode << (qint32)index << (qint64)value << opt << (qint64)result << data;
+		}
+		return result;
+	}
+	static void VSTCALLBACK setParameterProxy(AEffect * e, VstInt32 index, float value)
+	{
+		Data * r = of(e);
+		r->sets.fetchAndAddRelaxed(1);
+		r->setParameter(e, index, value);
+		if (r->recording.loadAcquire())
+		{
+			QMutexLocker locker(& r->lock);
+			r->begin(RecordSetParameter);
+			r->stream << (qint32)index << value;
+		}
+	}
+	static float VSTCALLBACK getParameterProxy(AEffect * e, VstInt32 index)
+	{
+		Data * r = of(e);
+		r->gets.fetchAndAddRelaxed(1);
+		const float value = r->getParameter(e, index);
+		if (r->recording.loadAcquire())
+		{
+			QMutexLocker locker(& r->lock);
+			r->begin(RecordGetParameter);
+			r->stream << (qint32)index << value;
+		}
+		return value;
+	}
+	static void VSTCALLBACK processProxy(AEffect * e, float ** in, float ** out, VstInt32 count)
+	{
+		Data * r = of(e);
+		r->processes.fetchAndAddRelaxed(1);
+		if (r->recording.loadAcquire())
+		{
+			r->process(e, in, out, count);
+			return;
+		}
+		r->processReplacing(e, in, out, count);
+	}
+	static void VSTCALLBACK processDoubleProxy(AEffect * e, double ** in, double ** out, VstInt32 count)
+	{
+		Data * r = of(e);
+		r->processes.fetchAndAddRelaxed(1);
+		if (r->recording.loadAcquire())
+		{
+			r->process(e, in, out, count);
+			return;
+		}
+		r->processDoubleReplacing(e, in, out, count);
+	}
+};
+
+QVstRecorder::QVstRecorder(): d(new Data())
+{
+}
+
+QVstRecorder::QVstRecorder(QVstPlugin & vst): d(new Data())
+{
+	attach(vst);
+}
+
+QVstRecorder::~QVstRecorder()
+{
+	detach();
+	delete d;
+}
+
+bool QVstRecorder::attach(QVstPlugin & vst)
+{
+	detach();
+	AEffect * e = (AEffect *)vst.lowLevelApi();
+	if (!vst.isLoaded() || e->resvd1)
+	{
+		return false;
+	}
+	d->vst = vst;
+	d->effect = e;
+	d->dispatcher = e->dispatcher;
+	d->setParameter = e->setParameter;
+	d->getParameter = e->getParameter;
+	d->processReplacing = e->processReplacing;
+	d->processDoubleReplacing = e->processDoubleReplacing;
+	e->resvd1 = (VstIntPtr)d;
+	e->dispatcher = Data::dispatcherProxy;
+	e->setParameter = Data::setParameterProxy;
+	e->getParameter = Data::getParameterProxy;
+	if (e->processReplacing)
+	{
+		e->processReplacing = Data::processProxy;
+	}
+	if (e->processDoubleReplacing)
+	{
+		e->processDoubleReplacing = Data::processDoubleProxy;
+	}
+	return true;
+}
+
+void QVstRecorder::detach()
+{
+	stopRecording();
+	d->restore();
+	d->vst = QVstPlugin();
+}
+
+bool QVstRecorder::isAttached() const
+{
+	return (d->effect != 0);
+}
+
+qint64 QVstRecorder::dispatchCount(int opcode) const
+{
+	return d->opcodes[qBound(0, opcode, (int)Data::Opcodes - 1)].load();
+}
+
+QMap<int, qint64> QVstRecorder::dispatchCounts() const
+{
+	QMap<int, qint64> counts;
+	for (int i = 0; i < Data::Opcodes; i++)
+	{
+		const qint64 n = d->opcodes[i].load();
+		if (n > 0)
+		{
+			counts[i] = n;
+		}
+	}
+	return counts;
+}
+
+qint64 QVstRecorder::setParameterCount() const
+{
+	return d->sets.load();
+}
+
+qint64 QVstRecorder::getParameterCount() const
+{
+	return d->gets.load();
+}
+
+qint64 QVstRecorder::processCount() const
+{
+	return d->processes.load();
+}
+
+void QVstRecorder::resetCounts()
+{
+	for (int i = 0; i < Data::Opcodes; i++)
+	{
+		d->opcodes[i].store(0);
+	}
+	d->sets.store(0);
+	d->gets.store(0);
+	d->processes.store(0);
+}
+
+bool QVstRecorder::startRecording(const QString & name, bool audio)
+{
+	stopRecording();
+	if (!d->effect)
+	{
+		return false;
+	}
+	QMutexLocker locker(& d->lock);
+	d->file.setFileName(name);
+	if (!d->file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+	{
+		return false;
+	}
+	d->stream.setDevice(& d->file);
+	d->stream.setByteOrder(QDataStream::LittleEndian);
+	d->stream.setFloatingPointPrecision(QDataStream::SinglePrecision);
+	d->stream.writeRawData(record_magic, sizeof(record_magic));
+	d->stream << (qint32)1 << (qint32)d->effect->numInputs << (qint32)d->effect->numOutputs << (qint32)d->effect->uniqueID << (qint32)d->effect->numParams << (qint32)d->effect->flags;
+	d->audio = audio;
+	d->clock.start();
+	d->recording.storeRelease(1);
+	return true;
+}
+
+void QVstRecorder::stopRecording()
+{
+	QMutexLocker locker(& d->lock);
+	if (!d->recording.loadAcquire())
+	{
+		return;
+	}
+	d->recording.storeRelease(0);
+	d->stream.setDevice(0);
+	d->file.close();
+}
+
+bool QVstRecorder::isRecording() const
+{
+	return d->recording.loadAcquire() != 0;
+}
+
+quint64 QVstRecorder::hash(const void * data, int bytes, quint64 h)
+{
+	const quint8 * p = (const quint8 *)data;
+	for (int i = 0; i < bytes; i++)
+	{
+		h = (h ^ p[i]) * Q_UINT64_C(1099511628211);
+	}
+	return h;
+}
+
+// replay
+
+QVstReplayer::Result::Result(): calls(0), skipped(0), processCalls(0), processNsecs(0), hashMismatches(0)
+{
+}
+
+template <class T>
+static bool replayProcess(AEffect * e, int count, const QByteArray & input, quint64 outhash, QVector<T> & buffer, QVstReplayer::Result & r)
+{
+	const int inputs = e->numInputs;
+	const int outputs = e->numOutputs;
+	if (count < 0 || (!input.isEmpty() && input.size() != inputs * count * (int)sizeof(T)))
+	{
+		return false;
+	}
+	if (buffer.count() < (inputs + outputs) * count)
+	{
+		buffer.resize((inputs + outputs) * count);
+	}
+	T * in = buffer.data();
+	T * out = in + inputs * count;
+	if (input.isEmpty())
+	{
+		memset(in, 0, inputs * count * sizeof(T));
+	}
+	else
+	{
+		memcpy(in, input.constData(), input.size());
+	}
+	QVarLengthArray<T *, 16> src(inputs);
+	QVarLengthArray<T *, 16> dst(outputs);
+	for (int k = 0; k < inputs; k++)
+	{
+		src[k] = in + k * count;
+	}
+	for (int k = 0; k < outputs; k++)
+	{
+		dst[k] = out + k * count;
+	}
+	QElapsedTimer timer;
+	timer.start();
+	if (sizeof(T) == sizeof(float))
+	{
+		e->processReplacing(e, (float **)src.data(), (float **)dst.data(), count);
+	}
+	else
+	{
+		e->processDoubleReplacing(e, (double **)src.data(), (double **)dst.data(), count);
+	}
+	r.processNsecs += timer.nsecsElapsed();
+	r.processCalls++;
+	if (!input.isEmpty() && QVstRecorder::hash(out, outputs * count * sizeof(T)) != outhash)
+	{
+		r.hashMismatches++;
+	}
+	return true;
+}
+
+bool QVstReplayer::replay(const QString & name, QVstPlugin & vst, Result * result)
+{
+	Result r;
+	QFile f(name);
+	if (!vst.isLoaded() || !f.open(QIODevice::ReadOnly))
+	{
+		return false;
+	}
+	QDataStream s(& f);
+	s.setByteOrder(QDataStream::LittleEndian);
+	s.setFloatingPointPrecision(QDataStream::SinglePrecision);
+	char magic[sizeof(record_magic)];
+	qint32 version = 0, inputs = 0, outputs = 0, id = 0, params = 0, flags = 0;
+	if (s.readRawData(magic, sizeof(magic)) != sizeof(magic) || memcmp(magic, record_magic, sizeof(magic)) != 0)
+	{
+		return false;
+	}
+	s >> version >> inputs >> outputs >> id >> params >> flags;
+	AEffect * e = (AEffect *)vst.lowLevelApi();
+	if (version != 1 || inputs != e->numInputs || outputs != e->numOutputs)
+	{
+		return false;
+	}
+	QByteArray scratch(65536, 0);
+	QVector<float> fbuffer;
+	QVector<double> dbuffer;
+	while (!s.atEnd() && s.status() == QDataStream::Ok)
+	{
+		quint8 type = 0;
+		qint64 ts = 0;
+		s >> type >> ts;
+		if (type == RecordDispatch)
+		{
+			qint32 opcode = 0, index = 0;
+			qint64 value = 0, ret = 0;
+			float opt = 0;
+			QByteArray data;
+			s >> opcode >> index >> value >> opt >> ret >> data;
+			if (!replayable(opcode))
+			{
+				r.skipped++;
+				continue;
+			}
+			memset(scratch.data(), 0, scratch.size());
+			void * ptr = scratch.data();
+			VstIntPtr v = (VstIntPtr)value;
+			if (opcode == effSetSpeakerArrangement && data.size() >= (int)sizeof(VstSpeakerArrangement))
+			{
+				v = (VstIntPtr)data.data();
+				ptr = data.data() + arrangementSize((const VstSpeakerArrangement *)data.constData());
+			}
+			else if (opcode == effGetSpeakerArrangement)
+			{
+				v = (VstIntPtr)scratch.data();
+				ptr = scratch.data() + sizeof(void *);
+			}
+			else if (!data.isEmpty())
+			{
+				ptr = data.data();
+			}
+			e->dispatcher(e, opcode, index, v, ptr, opt);
+		}
+		else if (type == RecordSetParameter || type == RecordGetParameter)
+		{
+			qint32 index = 0;
+			float value = 0;
+			s >> index >> value;
+			if (type == RecordSetParameter)
+			{
+				e->setParameter(e, index, value);
+			}
+			else
+			{
+				e->getParameter(e, index);
+			}
+		}
+		else if (type == RecordProcess)
+		{
+			quint8 precision = 0;
+			qint32 count = 0;
+			quint64 inhash = 0, outhash = 0;
+			QByteArray input;
+			s >> precision >> count >> inhash >> outhash >> input;
+			const bool ok = (precision == 64) ?
+				(e->processDoubleReplacing && replayProcess(e, count, input, outhash, dbuffer, r)) :
+				(e->processReplacing && replayProcess(e, count, input, outhash, fbuffer, r));
+			if (!ok)
+			{
+				return false;
+			}
+		}
+		else
+		{
+			return false;
+		}
+		r.calls++;
+	}
+	if (result)
+	{
+		* result = r;
+	}
+	return (s.status() == QDataStream::Ok);
+}
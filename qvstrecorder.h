@@ -0,0 +1,58 @@
+#ifndef QVSTRECORDER_H
+#define QVSTRECORDER_H
+
+#include "qvsthost.h"
+#include <QMap>
+
+// interposition on a loaded plugin: replaces the AEffect dispatcher, setParameter, getParameter and process callbacks,
+// counts the calls and optionally records them with FNV-1a hashes of the audio blocks, the plugin is kept loaded while attached
+class QVstRecorder
+{
+	struct Data;
+	Data * d;
+	QVstRecorder(const QVstRecorder &);
+	QVstRecorder & operator = (const QVstRecorder &);
+public:
+// ctor
+	QVstRecorder();
+	explicit QVstRecorder(QVstPlugin &);
+// dtor, detaches
+	~QVstRecorder();
+
+// attaching
+	bool attach(QVstPlugin &); // one recorder per plugin
+	void detach();
+	bool isAttached() const;
+
+// counting
+	qint64 dispatchCount(int) const; // opcode
+	QMap<int, qint64> dispatchCounts() const; // opcode - calls, called opcodes only
+	qint64 setParameterCount() const;
+	qint64 getParameterCount() const;
+	qint64 processCount() const; // processReplacing and processDoubleReplacing
+	void resetCounts();
+
+// recording, file io happens inside the plugin calls, not for realtime use
+	bool startRecording(const QString & file, bool audio = false); // audio - store the input blocks, replay then feeds them and checks the output hashes
+	void stopRecording();
+	bool isRecording() const;
+
+	static quint64 hash(const void *, int, quint64 h = Q_UINT64_C(14695981039346656037)); // FNV-1a 64, chain calls to hash several blocks
+};
+
+class QVstReplayer
+{
+public:
+	struct Result
+	{
+		qint64 calls; // replayed
+		qint64 skipped; // open/close, editor and vendor specific calls
+		qint64 processCalls;
+		qint64 processNsecs; // inside processReplacing
+		qint64 hashMismatches; // recordings with audio only
+		Result();
+	};
+	static bool replay(const QString & file, QVstPlugin &, Result * result = NULL); // false if the file or the plugin's pins don't match
+};
+
+#endif // QVSTRECORDER_H
@@ -0,0 +1,457 @@
+#include "qvstrender.h"
+#include "qvstsimd.h"
+#include <QFile>
+#include <QtEndian>
+#include <QVarLengthArray>
+#include <string.h>
+
+enum
+{
+	WaveFormatPcm = 1,
+	WaveFormatFloat = 3,
+	WaveFormatExtensible = 0xfffe,
+	Ds64Size = 28 // riff size, data size, sample count, table length
+};
+
+struct WavFormat
+{
+	int channels;
+	int rate;
+	int bits;
+	bool floats;
+	WavFormat(): channels(0), rate(0), bits(0), floats(false)
+	{
+	}
+	int frameBytes() const
+	{
+		return channels * bits / 8;
+	}
+	bool isSupported() const
+	{
+		return channels > 0 && rate > 0 && (floats ? bits == 32 : (bits == 16 || bits == 24 || bits == 32));
+	}
+};
+
+static bool readChunkHeader(QFile & f, char * id, quint32 & size)
+{
+	uchar h[8];
+	if (f.read((char *)h, 8) != 8)
+	{
+		return false;
+	}
+	memcpy(id, h, 4);
+	size = qFromLittleEndian<quint32>(h + 4);
+	return true;
+}
+
+// leaves the file at the first data byte
+static bool readWavHeader(QFile & f, WavFormat & format, qint64 & frames, QString & error)
+{
+	uchar riff[12];
+	if (f.read((char *)riff, 12) != 12 || qstrncmp((const char *)riff + 8, "WAVE", 4) != 0)
+	{
+		error = "not a WAV file";
+		return false;
+	}
+	const bool rf64 = (qstrncmp((const char *)riff, "RF64", 4) == 0 || qstrncmp((const char *)riff, "BW64", 4) == 0);
+	if (!rf64 && qstrncmp((const char *)riff, "RIFF", 4) != 0)
+	{
+		error = "not a WAV file";
+		return false;
+	}
+	qint64 data_size = -1;
+	bool has_format = false;
+	char id[4];
+	quint32 size;
+	while (readChunkHeader(f, id, size))
+	{
+		const qint64 next = f.pos() + size + (size & 1);
+		if (qstrncmp(id, "ds64", 4) == 0)
+		{
+			uchar ds64[Ds64Size];
+			if (size < (quint32)Ds64Size || f.read((char *)ds64, Ds64Size) != Ds64Size)
+			{
+				break;
+			}
+			data_size = qFromLittleEndian<quint64>(ds64 + 8);
+		}
+		else if (qstrncmp(id, "fmt ", 4) == 0)
+		{
+			uchar fmt[40];
+			memset(fmt, 0, sizeof(fmt));
+			const int n = qMin((int)size, (int)sizeof(fmt));
+			if (size < 16 || f.read((char *)fmt, n) != n)
+			{
+				break;
+			}
+			int tag = qFromLittleEndian<quint16>(fmt);
+			if (tag == WaveFormatExtensible && n >= 26)
+			{
+				tag = qFromLittleEndian<quint16>(fmt + 24); // sub format guid starts with the tag
+			}
+			format.channels = qFromLittleEndian<quint16>(fmt + 2);
+			format.rate = qFromLittleEndian<quint32>(fmt + 4);
+			format.bits = qFromLittleEndian<quint16>(fmt + 14);
+			format.floats = (tag == WaveFormatFloat);
+			if ((tag != WaveFormatPcm && tag != WaveFormatFloat) || !format.isSupported())
+			{
+				error = "unsupported sample format";
+				return false;
+			}
+			has_format = true;
+		}
+		else if (qstrncmp(id, "data", 4) == 0)
+		{
+			if (!has_format)
+			{
+				break;
+			}
+			if (!rf64 || size != 0xffffffff || data_size < 0)
+			{
+				data_size = size;
+			}
+			data_size = qMin(data_size, f.size() - f.pos());
+			frames = data_size / format.frameBytes();
+			return true;
+		}
+		if (!f.seek(next))
+		{
+			break;
+		}
+	}
+	error = "no format or data chunk";
+	return false;
+}
+
+// sizes are patched by finishWavHeader(), the JUNK chunk turns into ds64 for RF64
+static bool writeWavHeader(QFile & f, const WavFormat & format)
+{
+	uchar h[12 + 8 + Ds64Size + 8 + 16 + 8];
+	uchar * p = h;
+	memcpy(p, "RIFF\0\0\0\0WAVE", 12);
+	p += 12;
+	memcpy(p, "JUNK", 4);
+	qToLittleEndian<quint32>(Ds64Size, p + 4);
+	memset(p + 8, 0, Ds64Size);
+	p += 8 + Ds64Size;
+	memcpy(p, "fmt ", 4);
+	qToLittleEndian<quint32>(16, p + 4);
+	qToLittleEndian<quint16>(format.floats ? WaveFormatFloat : WaveFormatPcm, p + 8);
+	qToLittleEndian<quint16>(format.channels, p + 10);
+	qToLittleEndian<quint32>(format.rate, p + 12);
+	qToLittleEndian<quint32>(format.rate * format.frameBytes(), p + 16);
+	qToLittleEndian<quint16>(format.frameBytes(), p + 20);
+	qToLittleEndian<quint16>(format.bits, p + 22);
+	p += 24;
+	memcpy(p, "data\0\0\0\0", 8);
+	return f.write((const char *)h, sizeof(h)) == (qint64)sizeof(h);
+}
+
+static bool finishWavHeader(QFile & f, const WavFormat & format, qint64 data_size)
+{
+	if (data_size & 1)
+	{
+		f.write("", 1);
+	}
+	const qint64 riff_size = f.pos() - 8;
+	const qint64 data_pos = 12 + 8 + Ds64Size + 8 + 16;
+	uchar size[4];
+	if (riff_size <= Q_INT64_C(0xffffffff))
+	{
+		qToLittleEndian<quint32>((quint32)riff_size, size);
+		f.seek(4);
+		f.write((const char *)size, 4);
+		qToLittleEndian<quint32>((quint32)data_size, size);
+		f.seek(data_pos + 4);
+		return f.write((const char *)size, 4) == 4;
+	}
+	f.seek(0);
+	f.write("RF64\xff\xff\xff\xff", 8);
+	uchar ds64[8 + Ds64Size];
+	memcpy(ds64, "ds64", 4);
+	qToLittleEndian<quint32>(Ds64Size, ds64 + 4);
+	qToLittleEndian<quint64>(riff_size, ds64 + 8);
+	qToLittleEndian<quint64>(data_size, ds64 + 16);
+	qToLittleEndian<quint64>(data_size / format.frameBytes(), ds64 + 24);
+	qToLittleEndian<quint32>(0, ds64 + 32);
+	f.seek(12);
+	f.write((const char *)ds64, sizeof(ds64));
+	f.seek(data_pos + 4);
+	return f.write("\xff\xff\xff\xff", 4) == 4;
+}
+
+static void decode(const WavFormat & format, const char * raw, float * const * out, int frames)
+{
+	if (format.floats)
+	{
+		QVstSimd::deinterleave((const float *)raw, out, format.channels, frames);
+		return;
+	}
+	switch (format.bits)
+	{
+	case 16:
+		QVstSimd::fromInt16((const qint16 *)raw, out, format.channels, frames);
+		break;
+	case 24:
+		QVstSimd::fromInt24((const quint8 *)raw, out, format.channels, frames);
+		break;
+	case 32:
+		QVstSimd::fromInt32((const qint32 *)raw, out, format.channels, frames);
+		break;
+	}
+}
+
+static void encode(const WavFormat & format, const float * const * in, char * raw, int frames, quint32 * dither)
+{
+	if (format.floats)
+	{
+		QVstSimd::interleave(in, (float *)raw, format.channels, frames);
+		return;
+	}
+	switch (format.bits)
+	{
+	case 16:
+		QVstSimd::toInt16(in, (qint16 *)raw, format.channels, frames, dither);
+		break;
+	case 24:
+		QVstSimd::toInt24(in, (quint8 *)raw, format.channels, frames, dither);
+		break;
+	case 32:
+		QVstSimd::toInt32(in, (qint32 *)raw, format.channels, frames, dither);
+		break;
+	}
+}
+
+struct QVstRenderer::Data
+{
+	QVstChain chain;
+	int block;
+	SampleFormat format;
+	bool dither;
+	int defaulttail;
+	qint64 read;
+	qint64 written;
+	int rate;
+	QString error;
+	Data(const QVstChain & c): chain(c), block(4096), format(SameAsInput), dither(false), defaulttail(0), read(0), written(0), rate(0)
+	{
+	}
+	int tail() const
+	{
+		int frames = 0;
+		foreach (const QVstPlugin & vst, chain)
+		{
+			const int t = vst.tailSize();
+			frames += (t == 0) ? defaulttail : (t == 1 ? 0 : t);
+		}
+		return frames;
+	}
+	bool fail(const QString & e)
+	{
+		error = e;
+		return false;
+	}
+	bool abort(QFile & dst, const QString & e) // stops the chain and removes the partial output
+	{
+		chain.suspend();
+		dst.remove();
+		return fail(e);
+	}
+};
+
+QVstRenderer::QVstRenderer(const QVstChain & chain): d(new Data(chain))
+{
+}
+
+QVstRenderer::~QVstRenderer()
+{
+	delete d;
+}
+
+void QVstRenderer::setBlockSize(int frames)
+{
+	d->block = qMax(1, frames);
+}
+
+int QVstRenderer::blockSize() const
+{
+	return d->block;
+}
+
+void QVstRenderer::setOutputFormat(SampleFormat format)
+{
+	d->format = format;
+}
+
+QVstRenderer::SampleFormat QVstRenderer::outputFormat() const
+{
+	return d->format;
+}
+
+void QVstRenderer::setDither(bool state)
+{
+	d->dither = state;
+}
+
+bool QVstRenderer::dither() const
+{
+	return d->dither;
+}
+
+void QVstRenderer::setDefaultTail(int frames)
+{
+	d->defaulttail = qMax(0, frames);
+}
+
+int QVstRenderer::defaultTail() const
+{
+	return d->defaulttail;
+}
+
+bool QVstRenderer::render(const QString & input, const QString & output)
+{
+	d->read = 0;
+	d->written = 0;
+	d->rate = 0;
+	d->error.clear();
+	QFile src(input);
+	if (!src.open(QIODevice::ReadOnly))
+	{
+		return d->fail("can't open " + input);
+	}
+	WavFormat in_format;
+	qint64 frames = 0;
+	if (!readWavHeader(src, in_format, frames, d->error))
+	{
+		return false;
+	}
+	const int channels = in_format.channels;
+	d->rate = in_format.rate;
+	if (d->chain.isEmpty() || !d->chain.canProcessFloat() || !d->chain.canProcess(channels))
+	{
+		return d->fail("the chain can't process the file's channels");
+	}
+	WavFormat out_format = in_format;
+	switch (d->format)
+	{
+	case SameAsInput:
+		break;
+	case Int16:
+	case Int24:
+	case Int32:
+		out_format.floats = false;
+		out_format.bits = (d->format == Int16) ? 16 : (d->format == Int24 ? 24 : 32);
+		break;
+	case Float32:
+		out_format.floats = true;
+		out_format.bits = 32;
+		break;
+	}
+	QFile dst(output);
+	if (!dst.open(QIODevice::WriteOnly | QIODevice::Truncate))
+	{
+		return d->fail("can't write " + output);
+	}
+	if (!writeWavHeader(dst, out_format))
+	{
+		dst.remove();
+		return d->fail("can't write " + output);
+	}
+
+	const int block = d->block;
+	d->chain.suspend();
+	d->chain.setSampleRate(in_format.rate);
+	d->chain.setBlockSize(block);
+	d->chain.resume();
+	qint64 skip = d->chain.latency();
+	qint64 flush = skip + d->tail();
+	qint64 remaining = frames;
+	QVstAudioBuffer<float> in(channels, block);
+	QVstAudioBuffer<float> out(channels, block);
+	QVector<char> raw(block * qMax(in_format.frameBytes(), out_format.frameBytes()));
+	QVarLengthArray<const float *, 16> inptr(channels);
+	QVarLengthArray<float *, 16> outptr(channels);
+	QVarLengthArray<const float *, 16> encptr(channels);
+	for (int k = 0; k < channels; k++)
+	{
+		inptr[k] = in.channel(k);
+		outptr[k] = out.channel(k);
+	}
+	quint32 dither_state = 0x9e3779b9u;
+	quint32 * dither = d->dither ? & dither_state : 0;
+	qint64 data_size = 0;
+	while (remaining > 0 || flush > 0)
+	{
+		int n;
+		if (remaining > 0)
+		{
+			n = (int)qMin((qint64)block, remaining);
+			const qint64 bytes = (qint64)n * in_format.frameBytes();
+			if (src.read(raw.data(), bytes) != bytes)
+			{
+				return d->abort(dst, "can't read " + input);
+			}
+			decode(in_format, raw.constData(), (float * const *)inptr.constData(), n);
+			remaining -= n;
+			d->read += n;
+		}
+		else
+		{
+			n = (int)qMin((qint64)block, flush);
+			for (int k = 0; k < channels; k++)
+			{
+				memset(in.channel(k), 0, n * sizeof(float));
+			}
+			flush -= n;
+		}
+		if (!d->chain.process(inptr.data(), outptr.data(), channels, n))
+		{
+			return d->abort(dst, "the chain failed to process");
+		}
+		const int offset = (int)qMin((qint64)n, skip);
+		skip -= offset;
+		if (offset == n)
+		{
+			continue;
+		}
+		for (int k = 0; k < channels; k++)
+		{
+			encptr[k] = outptr[k] + offset;
+		}
+		encode(out_format, encptr.constData(), raw.data(), n - offset, dither);
+		const qint64 bytes = (qint64)(n - offset) * out_format.frameBytes();
+		if (dst.write(raw.constData(), bytes) != bytes)
+		{
+			return d->abort(dst, "can't write " + output);
+		}
+		data_size += bytes;
+		d->written += n - offset;
+	}
+	d->chain.suspend();
+	if (!finishWavHeader(dst, out_format, data_size))
+	{
+		dst.remove();
+		return d->fail("can't write " + output);
+	}
+	return true;
+}
+
+qint64 QVstRenderer::framesRead() const
+{
+	return d->read;
+}
+
+int QVstRenderer::sampleRate() const
+{
+	return d->rate;
+}
+
+qint64 QVstRenderer::framesWritten() const
+{
+	return d->written;
+}
+
+QString QVstRenderer::errorString() const
+{
+	return d->error;
+}
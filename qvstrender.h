@@ -0,0 +1,49 @@
+#ifndef QVSTRENDER_H
+#define QVSTRENDER_H
+
+#include "qvsthost.h"
+
+// streaming offline render of a WAV or RF64 file (16, 24, 32 bits integer or 32 bits float pcm) through a chain,
+// reads, processes and writes one block at a time, so memory doesn't grow with the file length,
+// the leading latency() frames are trimmed and the plugins' tails are flushed after the input ends,
+// outputs over 4 GB are written as RF64
+class QVstRenderer
+{
+	struct Data;
+	Data * d;
+	QVstRenderer(const QVstRenderer &);
+	QVstRenderer & operator = (const QVstRenderer &);
+public:
+	enum SampleFormat
+	{
+		SameAsInput,
+		Int16,
+		Int24,
+		Int32,
+		Float32
+	};
+
+// ctor, the chain is shared, render() suspends it, sets its sample rate and block size, resumes it and suspends it again when done
+	explicit QVstRenderer(const QVstChain &);
+// dtor
+	~QVstRenderer();
+
+// options
+	void setBlockSize(int); // frames, 4096 by default
+	int blockSize() const;
+	void setOutputFormat(SampleFormat);
+	SampleFormat outputFormat() const;
+	void setDither(bool); // TPDF dither for integer outputs
+	bool dither() const;
+	void setDefaultTail(int); // frames flushed for plugins with unknown tail (tailSize() 0), 0 by default
+	int defaultTail() const;
+
+// rendering
+	bool render(const QString & input, const QString & output);
+	qint64 framesRead() const; // of the last render
+	int sampleRate() const; // of the last input
+	qint64 framesWritten() const;
+	QString errorString() const;
+};
+
+#endif // QVSTRENDER_H
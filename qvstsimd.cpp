@@ -0,0 +1,1207 @@
+#include "qvstsimd.h"
+#include <QtGlobal>
+#include <string.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define QVSTHOST_SSE2
+#include <emmintrin.h>
+#endif
+
+#if defined(QVSTHOST_SSE2) && (defined(_MSC_VER) || defined(__GNUC__))
+#define QVSTHOST_AVX2
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define QVSTHOST_SSSE3_TARGET
+#define QVSTHOST_AVX2_TARGET
+#else
+#define QVSTHOST_SSSE3_TARGET __attribute__((target("ssse3")))
+#define QVSTHOST_AVX2_TARGET __attribute__((target("avx2")))
+#endif
+#endif
+
+static bool detectAvx2()
+{
+#if defined(QVSTHOST_AVX2) && defined(_MSC_VER)
+	int r[4];
+	__cpuid(r, 0);
+	if (r[0] < 7)
+	{
+		return false;
+	}
+	__cpuid(r, 1);
+	const bool osxsave = (r[2] & (1 << 27)) != 0;
+	const bool avx = (r[2] & (1 << 28)) != 0;
+	if (!osxsave || !avx || (_xgetbv(0) & 6) != 6)
+	{
+		return false;
+	}
+	__cpuidex(r, 7, 0);
+	return (r[1] & (1 << 5)) != 0;
+#elif defined(QVSTHOST_AVX2)
+	__builtin_cpu_init();
+	return __builtin_cpu_supports("avx2") != 0;
+#else
+	return false;
+#endif
+}
+
+static bool detectSsse3()
+{
+#if defined(QVSTHOST_AVX2) && defined(_MSC_VER)
+	int r[4];
+	__cpuid(r, 1);
+	return (r[2] & (1 << 9)) != 0;
+#elif defined(QVSTHOST_AVX2)
+	__builtin_cpu_init();
+	return __builtin_cpu_supports("ssse3") != 0;
+#else
+	return false;
+#endif
+}
+
+bool QVstSimd::hasSsse3()
+{
+	static const bool ssse3 = detectSsse3();
+	return ssse3;
+}
+
+bool QVstSimd::hasAvx2()
+{
+	static const bool avx2 = detectAvx2();
+	return avx2;
+}
+
+// silence
+
+bool QVstSimd::isSilent(const float * p, int count)
+{
+	int i = 0;
+#ifdef QVSTHOST_SSE2
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i abs_mask = _mm_set1_epi32(0x7fffffff);
+	for (; i + 16 <= count; i += 16)
+	{
+		__m128i acc = _mm_or_si128(
+			_mm_or_si128(_mm_loadu_si128((const __m128i *)(p + i)), _mm_loadu_si128((const __m128i *)(p + i + 4))),
+			_mm_or_si128(_mm_loadu_si128((const __m128i *)(p + i + 8)), _mm_loadu_si128((const __m128i *)(p + i + 12))));
+		acc = _mm_and_si128(acc, abs_mask);
+		if (_mm_movemask_epi8(_mm_cmpeq_epi32(acc, zero)) != 0xffff)
+		{
+			return false;
+		}
+	}
+#endif
+	for (; i < count; i++)
+	{
+		if (p[i] != 0.0f)
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+bool QVstSimd::isSilent(const double * p, int count)
+{
+	int i = 0;
+#ifdef QVSTHOST_SSE2
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i abs_mask = _mm_set_epi32(0x7fffffff, -1, 0x7fffffff, -1);
+	for (; i + 8 <= count; i += 8)
+	{
+		__m128i acc = _mm_or_si128(
+			_mm_or_si128(_mm_loadu_si128((const __m128i *)(p + i)), _mm_loadu_si128((const __m128i *)(p + i + 2))),
+			_mm_or_si128(_mm_loadu_si128((const __m128i *)(p + i + 4)), _mm_loadu_si128((const __m128i *)(p + i + 6))));
+		acc = _mm_and_si128(acc, abs_mask);
+		if (_mm_movemask_epi8(_mm_cmpeq_epi32(acc, zero)) != 0xffff)
+		{
+			return false;
+		}
+	}
+#endif
+	for (; i < count; i++)
+	{
+		if (p[i] != 0.0)
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+// denormals
+
+int QVstSimd::denormals(const float * p, int count)
+{
+	int n = 0;
+	int i = 0;
+#ifdef QVSTHOST_SSE2
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i abs_mask = _mm_set1_epi32(0x7fffffff);
+	const __m128i min_normal = _mm_set1_epi32(0x00800000);
+	__m128i acc = zero;
+	for (; i + 4 <= count; i += 4)
+	{
+		const __m128i v = _mm_and_si128(_mm_loadu_si128((const __m128i *)(p + i)), abs_mask);
+		acc = _mm_sub_epi32(acc, _mm_and_si128(_mm_cmpgt_epi32(v, zero), _mm_cmplt_epi32(v, min_normal)));
+	}
+	qint32 lanes[4];
+	_mm_storeu_si128((__m128i *)lanes, acc);
+	n = lanes[0] + lanes[1] + lanes[2] + lanes[3];
+#endif
+	for (; i < count; i++)
+	{
+		quint32 b;
+		memcpy(& b, p + i, sizeof(b));
+		b &= 0x7fffffffu;
+		if (b != 0 && b < 0x00800000u)
+		{
+			n++;
+		}
+	}
+	return n;
+}
+
+int QVstSimd::denormals(const double * p, int count)
+{
+	int n = 0;
+	for (int i = 0; i < count; i++)
+	{
+		quint64 b;
+		memcpy(& b, p + i, sizeof(b));
+		b &= Q_UINT64_C(0x7fffffffffffffff);
+		if (b != 0 && b < Q_UINT64_C(0x0010000000000000))
+		{
+			n++;
+		}
+	}
+	return n;
+}
+
+unsigned int QVstSimd::flushDenormals()
+{
+#ifdef QVSTHOST_SSE2
+	const unsigned int state = _mm_getcsr();
+	_mm_setcsr(state | 0x8040); // FTZ | DAZ
+	return state;
+#else
+	return 0;
+#endif
+}
+
+void QVstSimd::restoreDenormals(unsigned int state)
+{
+#ifdef QVSTHOST_SSE2
+	_mm_setcsr(state);
+#else
+	Q_UNUSED(state);
+#endif
+}
+
+// precision
+
+void QVstSimd::convert(const float * in, double * out, int count)
+{
+	int i = 0;
+#ifdef QVSTHOST_SSE2
+	for (; i + 4 <= count; i += 4)
+	{
+		const __m128 v = _mm_loadu_ps(in + i);
+		_mm_storeu_pd(out + i, _mm_cvtps_pd(v));
+		_mm_storeu_pd(out + i + 2, _mm_cvtps_pd(_mm_movehl_ps(v, v)));
+	}
+#endif
+	for (; i < count; i++)
+	{
+		out[i] = in[i];
+	}
+}
+
+void QVstSimd::convert(const double * in, float * out, int count)
+{
+	int i = 0;
+#ifdef QVSTHOST_SSE2
+	for (; i + 4 <= count; i += 4)
+	{
+		const __m128 lo = _mm_cvtpd_ps(_mm_loadu_pd(in + i));
+		const __m128 hi = _mm_cvtpd_ps(_mm_loadu_pd(in + i + 2));
+		_mm_storeu_ps(out + i, _mm_movelh_ps(lo, hi));
+	}
+#endif
+	for (; i < count; i++)
+	{
+		out[i] = float(in[i]);
+	}
+}
+
+void QVstSimd::convert(const float * in, float * out, int count)
+{
+	if (in != out)
+	{
+		memcpy(out, in, count * sizeof(float));
+	}
+}
+
+void QVstSimd::convert(const double * in, double * out, int count)
+{
+	if (in != out)
+	{
+		memcpy(out, in, count * sizeof(double));
+	}
+}
+
+// gain
+
+void QVstSimd::scale(const float * in, float * out, float gain, int count)
+{
+	int i = 0;
+#ifdef QVSTHOST_SSE2
+	const __m128 g = _mm_set1_ps(gain);
+	for (; i + 8 <= count; i += 8)
+	{
+		_mm_storeu_ps(out + i, _mm_mul_ps(_mm_loadu_ps(in + i), g));
+		_mm_storeu_ps(out + i + 4, _mm_mul_ps(_mm_loadu_ps(in + i + 4), g));
+	}
+#endif
+	for (; i < count; i++)
+	{
+		out[i] = in[i] * gain;
+	}
+}
+
+void QVstSimd::scale(const double * in, double * out, double gain, int count)
+{
+	int i = 0;
+#ifdef QVSTHOST_SSE2
+	const __m128d g = _mm_set1_pd(gain);
+	for (; i + 4 <= count; i += 4)
+	{
+		_mm_storeu_pd(out + i, _mm_mul_pd(_mm_loadu_pd(in + i), g));
+		_mm_storeu_pd(out + i + 2, _mm_mul_pd(_mm_loadu_pd(in + i + 2), g));
+	}
+#endif
+	for (; i < count; i++)
+	{
+		out[i] = in[i] * gain;
+	}
+}
+
+void QVstSimd::mix(const float * in, float * out, float gain, int count)
+{
+	int i = 0;
+#ifdef QVSTHOST_SSE2
+	const __m128 g = _mm_set1_ps(gain);
+	for (; i + 8 <= count; i += 8)
+	{
+		_mm_storeu_ps(out + i, _mm_add_ps(_mm_loadu_ps(out + i), _mm_mul_ps(_mm_loadu_ps(in + i), g)));
+		_mm_storeu_ps(out + i + 4, _mm_add_ps(_mm_loadu_ps(out + i + 4), _mm_mul_ps(_mm_loadu_ps(in + i + 4), g)));
+	}
+#endif
+	for (; i < count; i++)
+	{
+		out[i] += in[i] * gain;
+	}
+}
+
+void QVstSimd::mix(const double * in, double * out, double gain, int count)
+{
+	int i = 0;
+#ifdef QVSTHOST_SSE2
+	const __m128d g = _mm_set1_pd(gain);
+	for (; i + 4 <= count; i += 4)
+	{
+		_mm_storeu_pd(out + i, _mm_add_pd(_mm_loadu_pd(out + i), _mm_mul_pd(_mm_loadu_pd(in + i), g)));
+		_mm_storeu_pd(out + i + 2, _mm_add_pd(_mm_loadu_pd(out + i + 2), _mm_mul_pd(_mm_loadu_pd(in + i + 2), g)));
+	}
+#endif
+	for (; i < count; i++)
+	{
+		out[i] += in[i] * gain;
+	}
+}
+
+// interleaving, vector kernels return the frames done, the scalar ones finish from there
+
+template <class T, int C>
+static void deinterleaveN(const T * in, T * const * out, int first, int frames)
+{
+	for (int f = first; f < frames; f++)
+	{
+		for (int c = 0; c < C; c++)
+		{
+			out[c][f] = in[f * C + c];
+		}
+	}
+}
+
+template <class T, int C>
+static void interleaveN(const T * const * in, T * out, int first, int frames)
+{
+	for (int f = first; f < frames; f++)
+	{
+		for (int c = 0; c < C; c++)
+		{
+			out[f * C + c] = in[c][f];
+		}
+	}
+}
+
+template <class T>
+static void deinterleaveAny(const T * in, T * const * out, int channels, int frames)
+{
+	for (int c = 0; c < channels; c++)
+	{
+		T * o = out[c];
+		const T * i = in + c;
+		for (int f = 0; f < frames; f++, i += channels)
+		{
+			o[f] = * i;
+		}
+	}
+}
+
+template <class T>
+static void interleaveAny(const T * const * in, T * out, int channels, int frames)
+{
+	for (int c = 0; c < channels; c++)
+	{
+		const T * i = in[c];
+		T * o = out + c;
+		for (int f = 0; f < frames; f++, o += channels)
+		{
+			* o = i[f];
+		}
+	}
+}
+
+#ifdef QVSTHOST_SSE2
+static int deinterleave2Sse(const float * in, float * const * out, int frames)
+{
+	float * l = out[0];
+	float * r = out[1];
+	int f = 0;
+	for (; f + 4 <= frames; f += 4)
+	{
+		const __m128 a = _mm_loadu_ps(in + 2 * f);
+		const __m128 b = _mm_loadu_ps(in + 2 * f + 4);
+		_mm_storeu_ps(l + f, _mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0)));
+		_mm_storeu_ps(r + f, _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1)));
+	}
+	return f;
+}
+
+static int interleave2Sse(const float * const * in, float * out, int frames)
+{
+	const float * l = in[0];
+	const float * r = in[1];
+	int f = 0;
+	for (; f + 4 <= frames; f += 4)
+	{
+		const __m128 a = _mm_loadu_ps(l + f);
+		const __m128 b = _mm_loadu_ps(r + f);
+		_mm_storeu_ps(out + 2 * f, _mm_unpacklo_ps(a, b));
+		_mm_storeu_ps(out + 2 * f + 4, _mm_unpackhi_ps(a, b));
+	}
+	return f;
+}
+
+static int deinterleave6Sse(const float * in, float * const * out, int frames)
+{
+	int f = 0;
+	for (; f + 4 <= frames; f += 4)
+	{
+		const float * i = in + 6 * f;
+		__m128 r0 = _mm_loadu_ps(i);
+		__m128 r1 = _mm_loadu_ps(i + 6);
+		__m128 r2 = _mm_loadu_ps(i + 12);
+		__m128 r3 = _mm_loadu_ps(i + 18);
+		_MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+		_mm_storeu_ps(out[0] + f, r0);
+		_mm_storeu_ps(out[1] + f, r1);
+		_mm_storeu_ps(out[2] + f, r2);
+		_mm_storeu_ps(out[3] + f, r3);
+		const __m128 a = _mm_loadh_pi(_mm_loadl_pi(_mm_setzero_ps(), (const __m64 *)(i + 4)), (const __m64 *)(i + 10));
+		const __m128 b = _mm_loadh_pi(_mm_loadl_pi(_mm_setzero_ps(), (const __m64 *)(i + 16)), (const __m64 *)(i + 22));
+		_mm_storeu_ps(out[4] + f, _mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0)));
+		_mm_storeu_ps(out[5] + f, _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1)));
+	}
+	return f;
+}
+
+static int interleave6Sse(const float * const * in, float * out, int frames)
+{
+	int f = 0;
+	for (; f + 4 <= frames; f += 4)
+	{
+		float * o = out + 6 * f;
+		__m128 r0 = _mm_loadu_ps(in[0] + f);
+		__m128 r1 = _mm_loadu_ps(in[1] + f);
+		__m128 r2 = _mm_loadu_ps(in[2] + f);
+		__m128 r3 = _mm_loadu_ps(in[3] + f);
+		_MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+		_mm_storeu_ps(o, r0);
+		_mm_storeu_ps(o + 6, r1);
+		_mm_storeu_ps(o + 12, r2);
+		_mm_storeu_ps(o + 18, r3);
+		const __m128 c4 = _mm_loadu_ps(in[4] + f);
+		const __m128 c5 = _mm_loadu_ps(in[5] + f);
+		const __m128 a = _mm_unpacklo_ps(c4, c5);
+		const __m128 b = _mm_unpackhi_ps(c4, c5);
+		_mm_storel_pi((__m64 *)(o + 4), a);
+		_mm_storeh_pi((__m64 *)(o + 10), a);
+		_mm_storel_pi((__m64 *)(o + 16), b);
+		_mm_storeh_pi((__m64 *)(o + 22), b);
+	}
+	return f;
+}
+
+static int deinterleave8Sse(const float * in, float * const * out, int frames)
+{
+	int f = 0;
+	for (; f + 4 <= frames; f += 4)
+	{
+		for (int g = 0; g < 8; g += 4)
+		{
+			const float * i = in + 8 * f + g;
+			__m128 r0 = _mm_loadu_ps(i);
+			__m128 r1 = _mm_loadu_ps(i + 8);
+			__m128 r2 = _mm_loadu_ps(i + 16);
+			__m128 r3 = _mm_loadu_ps(i + 24);
+			_MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+			_mm_storeu_ps(out[g] + f, r0);
+			_mm_storeu_ps(out[g + 1] + f, r1);
+			_mm_storeu_ps(out[g + 2] + f, r2);
+			_mm_storeu_ps(out[g + 3] + f, r3);
+		}
+	}
+	return f;
+}
+
+static int interleave8Sse(const float * const * in, float * out, int frames)
+{
+	int f = 0;
+	for (; f + 4 <= frames; f += 4)
+	{
+		for (int g = 0; g < 8; g += 4)
+		{
+			float * o = out + 8 * f + g;
+			__m128 r0 = _mm_loadu_ps(in[g] + f);
+			__m128 r1 = _mm_loadu_ps(in[g + 1] + f);
+			__m128 r2 = _mm_loadu_ps(in[g + 2] + f);
+			__m128 r3 = _mm_loadu_ps(in[g + 3] + f);
+			_MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+			_mm_storeu_ps(o, r0);
+			_mm_storeu_ps(o + 8, r1);
+			_mm_storeu_ps(o + 16, r2);
+			_mm_storeu_ps(o + 24, r3);
+		}
+	}
+	return f;
+}
+
+static int deinterleave2Sse(const double * in, double * const * out, int frames)
+{
+	double * l = out[0];
+	double * r = out[1];
+	int f = 0;
+	for (; f + 2 <= frames; f += 2)
+	{
+		const __m128d a = _mm_loadu_pd(in + 2 * f);
+		const __m128d b = _mm_loadu_pd(in + 2 * f + 2);
+		_mm_storeu_pd(l + f, _mm_unpacklo_pd(a, b));
+		_mm_storeu_pd(r + f, _mm_unpackhi_pd(a, b));
+	}
+	return f;
+}
+
+static int interleave2Sse(const double * const * in, double * out, int frames)
+{
+	const double * l = in[0];
+	const double * r = in[1];
+	int f = 0;
+	for (; f + 2 <= frames; f += 2)
+	{
+		const __m128d a = _mm_loadu_pd(l + f);
+		const __m128d b = _mm_loadu_pd(r + f);
+		_mm_storeu_pd(out + 2 * f, _mm_unpacklo_pd(a, b));
+		_mm_storeu_pd(out + 2 * f + 2, _mm_unpackhi_pd(a, b));
+	}
+	return f;
+}
+#endif
+
+#ifdef QVSTHOST_AVX2
+QVSTHOST_AVX2_TARGET static inline void transpose8(__m256 & r0, __m256 & r1, __m256 & r2, __m256 & r3, __m256 & r4, __m256 & r5, __m256 & r6, __m256 & r7)
+{
+	const __m256 t0 = _mm256_unpacklo_ps(r0, r1);
+	const __m256 t1 = _mm256_unpackhi_ps(r0, r1);
+	const __m256 t2 = _mm256_unpacklo_ps(r2, r3);
+	const __m256 t3 = _mm256_unpackhi_ps(r2, r3);
+	const __m256 t4 = _mm256_unpacklo_ps(r4, r5);
+	const __m256 t5 = _mm256_unpackhi_ps(r4, r5);
+	const __m256 t6 = _mm256_unpacklo_ps(r6, r7);
+	const __m256 t7 = _mm256_unpackhi_ps(r6, r7);
+	const __m256 s0 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(1, 0, 1, 0));
+	const __m256 s1 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(3, 2, 3, 2));
+	const __m256 s2 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(1, 0, 1, 0));
+	const __m256 s3 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(3, 2, 3, 2));
+	const __m256 s4 = _mm256_shuffle_ps(t4, t6, _MM_SHUFFLE(1, 0, 1, 0));
+	const __m256 s5 = _mm256_shuffle_ps(t4, t6, _MM_SHUFFLE(3, 2, 3, 2));
+	const __m256 s6 = _mm256_shuffle_ps(t5, t7, _MM_SHUFFLE(1, 0, 1, 0));
+	const __m256 s7 = _mm256_shuffle_ps(t5, t7, _MM_SHUFFLE(3, 2, 3, 2));
+	r0 = _mm256_permute2f128_ps(s0, s4, 0x20);
+	r1 = _mm256_permute2f128_ps(s1, s5, 0x20);
+	r2 = _mm256_permute2f128_ps(s2, s6, 0x20);
+	r3 = _mm256_permute2f128_ps(s3, s7, 0x20);
+	r4 = _mm256_permute2f128_ps(s0, s4, 0x31);
+	r5 = _mm256_permute2f128_ps(s1, s5, 0x31);
+	r6 = _mm256_permute2f128_ps(s2, s6, 0x31);
+	r7 = _mm256_permute2f128_ps(s3, s7, 0x31);
+}
+
+QVSTHOST_AVX2_TARGET static int deinterleave2Avx2(const float * in, float * const * out, int frames)
+{
+	float * l = out[0];
+	float * r = out[1];
+	int f = 0;
+	for (; f + 8 <= frames; f += 8)
+	{
+		const __m256 a = _mm256_loadu_ps(in + 2 * f);
+		const __m256 b = _mm256_loadu_ps(in + 2 * f + 8);
+		const __m256 ls = _mm256_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0));
+		const __m256 rs = _mm256_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1));
+		_mm256_storeu_ps(l + f, _mm256_castpd_ps(_mm256_permute4x64_pd(_mm256_castps_pd(ls), _MM_SHUFFLE(3, 1, 2, 0))));
+		_mm256_storeu_ps(r + f, _mm256_castpd_ps(_mm256_permute4x64_pd(_mm256_castps_pd(rs), _MM_SHUFFLE(3, 1, 2, 0))));
+	}
+	return f;
+}
+
+QVSTHOST_AVX2_TARGET static int interleave2Avx2(const float * const * in, float * out, int frames)
+{
+	const float * l = in[0];
+	const float * r = in[1];
+	int f = 0;
+	for (; f + 8 <= frames; f += 8)
+	{
+		const __m256 a = _mm256_loadu_ps(l + f);
+		const __m256 b = _mm256_loadu_ps(r + f);
+		const __m256 lo = _mm256_unpacklo_ps(a, b);
+		const __m256 hi = _mm256_unpackhi_ps(a, b);
+		_mm256_storeu_ps(out + 2 * f, _mm256_permute2f128_ps(lo, hi, 0x20));
+		_mm256_storeu_ps(out + 2 * f + 8, _mm256_permute2f128_ps(lo, hi, 0x31));
+	}
+	return f;
+}
+
+QVSTHOST_AVX2_TARGET static int deinterleave8Avx2(const float * in, float * const * out, int frames)
+{
+	int f = 0;
+	for (; f + 8 <= frames; f += 8)
+	{
+		const float * i = in + 8 * f;
+		__m256 r0 = _mm256_loadu_ps(i);
+		__m256 r1 = _mm256_loadu_ps(i + 8);
+		__m256 r2 = _mm256_loadu_ps(i + 16);
+		__m256 r3 = _mm256_loadu_ps(i + 24);
+		__m256 r4 = _mm256_loadu_ps(i + 32);
+		__m256 r5 = _mm256_loadu_ps(i + 40);
+		__m256 r6 = _mm256_loadu_ps(i + 48);
+		__m256 r7 = _mm256_loadu_ps(i + 56);
+		transpose8(r0, r1, r2, r3, r4, r5, r6, r7);
+		_mm256_storeu_ps(out[0] + f, r0);
+		_mm256_storeu_ps(out[1] + f, r1);
+		_mm256_storeu_ps(out[2] + f, r2);
+		_mm256_storeu_ps(out[3] + f, r3);
+		_mm256_storeu_ps(out[4] + f, r4);
+		_mm256_storeu_ps(out[5] + f, r5);
+		_mm256_storeu_ps(out[6] + f, r6);
+		_mm256_storeu_ps(out[7] + f, r7);
+	}
+	return f;
+}
+
+QVSTHOST_AVX2_TARGET static int interleave8Avx2(const float * const * in, float * out, int frames)
+{
+	int f = 0;
+	for (; f + 8 <= frames; f += 8)
+	{
+		float * o = out + 8 * f;
+		__m256 r0 = _mm256_loadu_ps(in[0] + f);
+		__m256 r1 = _mm256_loadu_ps(in[1] + f);
+		__m256 r2 = _mm256_loadu_ps(in[2] + f);
+		__m256 r3 = _mm256_loadu_ps(in[3] + f);
+		__m256 r4 = _mm256_loadu_ps(in[4] + f);
+		__m256 r5 = _mm256_loadu_ps(in[5] + f);
+		__m256 r6 = _mm256_loadu_ps(in[6] + f);
+		__m256 r7 = _mm256_loadu_ps(in[7] + f);
+		transpose8(r0, r1, r2, r3, r4, r5, r6, r7);
+		_mm256_storeu_ps(o, r0);
+		_mm256_storeu_ps(o + 8, r1);
+		_mm256_storeu_ps(o + 16, r2);
+		_mm256_storeu_ps(o + 24, r3);
+		_mm256_storeu_ps(o + 32, r4);
+		_mm256_storeu_ps(o + 40, r5);
+		_mm256_storeu_ps(o + 48, r6);
+		_mm256_storeu_ps(o + 56, r7);
+	}
+	return f;
+}
+#endif
+
+void QVstSimd::deinterleave(const float * in, float * const * out, int channels, int frames)
+{
+	int f = 0;
+	switch (channels)
+	{
+	case 1:
+		convert(in, out[0], frames);
+		return;
+	case 2:
+#ifdef QVSTHOST_AVX2
+		if (hasAvx2())
+		{
+			f = deinterleave2Avx2(in, out, frames);
+		}
+#endif
+#ifdef QVSTHOST_SSE2
+		if (f == 0)
+		{
+			f = deinterleave2Sse(in, out, frames);
+		}
+#endif
+		deinterleaveN<float, 2>(in, out, f, frames);
+		return;
+	case 6:
+#ifdef QVSTHOST_SSE2
+		f = deinterleave6Sse(in, out, frames);
+#endif
+		deinterleaveN<float, 6>(in, out, f, frames);
+		return;
+	case 8:
+#ifdef QVSTHOST_AVX2
+		if (hasAvx2())
+		{
+			f = deinterleave8Avx2(in, out, frames);
+		}
+#endif
+#ifdef QVSTHOST_SSE2
+		if (f == 0)
+		{
+			f = deinterleave8Sse(in, out, frames);
+		}
+#endif
+		deinterleaveN<float, 8>(in, out, f, frames);
+		return;
+	}
+	deinterleaveAny(in, out, channels, frames);
+}
+
+void QVstSimd::interleave(const float * const * in, float * out, int channels, int frames)
+{
+	int f = 0;
+	switch (channels)
+	{
+	case 1:
+		convert(in[0], out, frames);
+		return;
+	case 2:
+#ifdef QVSTHOST_AVX2
+		if (hasAvx2())
+		{
+			f = interleave2Avx2(in, out, frames);
+		}
+#endif
+#ifdef QVSTHOST_SSE2
+		if (f == 0)
+		{
+			f = interleave2Sse(in, out, frames);
+		}
+#endif
+		interleaveN<float, 2>(in, out, f, frames);
+		return;
+	case 6:
+#ifdef QVSTHOST_SSE2
+		f = interleave6Sse(in, out, frames);
+#endif
+		interleaveN<float, 6>(in, out, f, frames);
+		return;
+	case 8:
+#ifdef QVSTHOST_AVX2
+		if (hasAvx2())
+		{
+			f = interleave8Avx2(in, out, frames);
+		}
+#endif
+#ifdef QVSTHOST_SSE2
+		if (f == 0)
+		{
+			f = interleave8Sse(in, out, frames);
+		}
+#endif
+		interleaveN<float, 8>(in, out, f, frames);
+		return;
+	}
+	interleaveAny(in, out, channels, frames);
+}
+
+void QVstSimd::deinterleave(const double * in, double * const * out, int channels, int frames)
+{
+	int f = 0;
+	switch (channels)
+	{
+	case 1:
+		convert(in, out[0], frames);
+		return;
+	case 2:
+#ifdef QVSTHOST_SSE2
+		f = deinterleave2Sse(in, out, frames);
+#endif
+		deinterleaveN<double, 2>(in, out, f, frames);
+		return;
+	case 6:
+		deinterleaveN<double, 6>(in, out, 0, frames);
+		return;
+	case 8:
+		deinterleaveN<double, 8>(in, out, 0, frames);
+		return;
+	}
+	deinterleaveAny(in, out, channels, frames);
+}
+
+void QVstSimd::interleave(const double * const * in, double * out, int channels, int frames)
+{
+	int f = 0;
+	switch (channels)
+	{
+	case 1:
+		convert(in[0], out, frames);
+		return;
+	case 2:
+#ifdef QVSTHOST_SSE2
+		f = interleave2Sse(in, out, frames);
+#endif
+		interleaveN<double, 2>(in, out, f, frames);
+		return;
+	case 6:
+		interleaveN<double, 6>(in, out, 0, frames);
+		return;
+	case 8:
+		interleaveN<double, 8>(in, out, 0, frames);
+		return;
+	}
+	interleaveAny(in, out, channels, frames);
+}
+
+// integer pcm
+
+struct Int16Pcm
+{
+	typedef qint16 Sample;
+	enum { width = 1 };
+	static float scale()
+	{
+		return 32768.0f;
+	}
+	static float maximum()
+	{
+		return 32767.0f;
+	}
+	static qint32 read(const qint16 * p)
+	{
+		return * p;
+	}
+	static void write(qint16 * p, qint32 v)
+	{
+		* p = qint16(v);
+	}
+};
+
+struct Int24Pcm
+{
+	typedef quint8 Sample;
+	enum { width = 3 };
+	static float scale()
+	{
+		return 8388608.0f;
+	}
+	static float maximum()
+	{
+		return 8388607.0f;
+	}
+	static qint32 read(const quint8 * p)
+	{
+		return qint32((quint32(p[0]) << 8) | (quint32(p[1]) << 16) | (quint32(p[2]) << 24)) >> 8;
+	}
+	static void write(quint8 * p, qint32 v)
+	{
+		p[0] = quint8(v);
+		p[1] = quint8(v >> 8);
+		p[2] = quint8(v >> 16);
+	}
+};
+
+struct Int32Pcm
+{
+	typedef qint32 Sample;
+	enum { width = 1 };
+	static float scale()
+	{
+		return 2147483648.0f;
+	}
+	static float maximum()
+	{
+		return 2147483520.0f; // largest float below 2^31
+	}
+	static qint32 read(const qint32 * p)
+	{
+		return * p;
+	}
+	static void write(qint32 * p, qint32 v)
+	{
+		* p = v;
+	}
+};
+
+static inline quint32 xorshift(quint32 & s)
+{
+	s ^= s << 13;
+	s ^= s >> 17;
+	s ^= s << 5;
+	return s;
+}
+
+// triangular noise in (-1, 1) lsb
+static inline float tpdf(quint32 & s)
+{
+	const float k = 1.0f / 16777216.0f;
+	const float a = (xorshift(s) >> 8) * k;
+	const float b = (xorshift(s) >> 8) * k;
+	return a - b;
+}
+
+template <class F>
+static void fromPcmAny(const typename F::Sample * in, float * const * out, int channels, int first, int frames)
+{
+	const float k = 1.0f / F::scale();
+	for (int c = 0; c < channels; c++)
+	{
+		float * o = out[c];
+		const typename F::Sample * i = in + (first * channels + c) * F::width;
+		for (int f = first; f < frames; f++, i += channels * F::width)
+		{
+			o[f] = F::read(i) * k;
+		}
+	}
+}
+
+template <class F>
+static void toPcmAny(const float * const * in, typename F::Sample * out, int channels, int first, int frames, quint32 * dither)
+{
+	const float scale = F::scale();
+	const float hi = F::maximum();
+	quint32 s = dither ? * dither : 0;
+	typename F::Sample * o = out + first * channels * F::width;
+	for (int f = first; f < frames; f++)
+	{
+		for (int c = 0; c < channels; c++, o += F::width)
+		{
+			float v = in[c][f] * scale;
+			if (dither)
+			{
+				v += tpdf(s);
+			}
+			F::write(o, qRound(qBound(-scale, v, hi)));
+		}
+	}
+	if (dither)
+	{
+		* dither = s;
+	}
+}
+
+#ifdef QVSTHOST_SSE2
+// 4 lanes of the dither generator, seeded from the scalar state
+struct Dither4
+{
+	__m128i s;
+	bool on;
+	Dither4(quint32 * dither): on(dither != 0)
+	{
+		quint32 x = (dither && * dither) ? * dither : 0x9e3779b9u;
+		const quint32 a = xorshift(x);
+		const quint32 b = xorshift(x);
+		const quint32 c = xorshift(x);
+		const quint32 d = xorshift(x);
+		s = _mm_setr_epi32(int(a), int(b), int(c), int(d));
+		if (dither)
+		{
+			* dither = xorshift(x);
+		}
+	}
+	__m128 uniform()
+	{
+		s = _mm_xor_si128(s, _mm_slli_epi32(s, 13));
+		s = _mm_xor_si128(s, _mm_srli_epi32(s, 17));
+		s = _mm_xor_si128(s, _mm_slli_epi32(s, 5));
+		return _mm_sub_ps(_mm_castsi128_ps(_mm_or_si128(_mm_srli_epi32(s, 9), _mm_set1_epi32(0x3f800000))), _mm_set1_ps(1.0f));
+	}
+	__m128 apply(__m128 v)
+	{
+		if (!on)
+		{
+			return v;
+		}
+		const __m128 a = uniform();
+		return _mm_add_ps(v, _mm_sub_ps(a, uniform()));
+	}
+};
+
+// scale, dither, clamp and round 4 samples
+static inline __m128i quantize(__m128 v, __m128 scale, __m128 lo, __m128 hi, Dither4 & d)
+{
+	return _mm_cvtps_epi32(_mm_min_ps(_mm_max_ps(d.apply(_mm_mul_ps(v, scale)), lo), hi));
+}
+
+static inline __m128 widen16(__m128i v, bool high, __m128 k)
+{
+	const __m128i x = high ? _mm_unpackhi_epi16(v, v) : _mm_unpacklo_epi16(v, v);
+	return _mm_mul_ps(_mm_cvtepi32_ps(_mm_srai_epi32(x, 16)), k);
+}
+
+static int fromInt16Sse(const qint16 * in, float * const * out, int channels, int frames)
+{
+	const __m128 k = _mm_set1_ps(1.0f / Int16Pcm::scale());
+	int f = 0;
+	if (channels == 1)
+	{
+		for (; f + 8 <= frames; f += 8)
+		{
+			const __m128i v = _mm_loadu_si128((const __m128i *)(in + f));
+			_mm_storeu_ps(out[0] + f, widen16(v, false, k));
+			_mm_storeu_ps(out[0] + f + 4, widen16(v, true, k));
+		}
+	}
+	else if (channels == 2)
+	{
+		for (; f + 4 <= frames; f += 4)
+		{
+			const __m128i v = _mm_loadu_si128((const __m128i *)(in + 2 * f));
+			const __m128 a = widen16(v, false, k);
+			const __m128 b = widen16(v, true, k);
+			_mm_storeu_ps(out[0] + f, _mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0)));
+			_mm_storeu_ps(out[1] + f, _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1)));
+		}
+	}
+	return f;
+}
+
+static int toInt16Sse(const float * const * in, qint16 * out, int channels, int frames, Dither4 & d)
+{
+	const __m128 scale = _mm_set1_ps(Int16Pcm::scale());
+	const __m128 lo = _mm_set1_ps(-Int16Pcm::scale());
+	const __m128 hi = _mm_set1_ps(Int16Pcm::maximum());
+	int f = 0;
+	if (channels == 1)
+	{
+		for (; f + 8 <= frames; f += 8)
+		{
+			const __m128i a = quantize(_mm_loadu_ps(in[0] + f), scale, lo, hi, d);
+			const __m128i b = quantize(_mm_loadu_ps(in[0] + f + 4), scale, lo, hi, d);
+			_mm_storeu_si128((__m128i *)(out + f), _mm_packs_epi32(a, b));
+		}
+	}
+	else if (channels == 2)
+	{
+		for (; f + 4 <= frames; f += 4)
+		{
+			const __m128 l = _mm_loadu_ps(in[0] + f);
+			const __m128 r = _mm_loadu_ps(in[1] + f);
+			const __m128i a = quantize(_mm_unpacklo_ps(l, r), scale, lo, hi, d);
+			const __m128i b = quantize(_mm_unpackhi_ps(l, r), scale, lo, hi, d);
+			_mm_storeu_si128((__m128i *)(out + 2 * f), _mm_packs_epi32(a, b));
+		}
+	}
+	return f;
+}
+
+static int fromInt32Sse(const qint32 * in, float * const * out, int channels, int frames)
+{
+	const __m128 k = _mm_set1_ps(1.0f / Int32Pcm::scale());
+	int f = 0;
+	if (channels == 1)
+	{
+		for (; f + 4 <= frames; f += 4)
+		{
+			_mm_storeu_ps(out[0] + f, _mm_mul_ps(_mm_cvtepi32_ps(_mm_loadu_si128((const __m128i *)(in + f))), k));
+		}
+	}
+	else if (channels == 2)
+	{
+		for (; f + 4 <= frames; f += 4)
+		{
+			const __m128 a = _mm_mul_ps(_mm_cvtepi32_ps(_mm_loadu_si128((const __m128i *)(in + 2 * f))), k);
+			const __m128 b = _mm_mul_ps(_mm_cvtepi32_ps(_mm_loadu_si128((const __m128i *)(in + 2 * f + 4))), k);
+			_mm_storeu_ps(out[0] + f, _mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0)));
+			_mm_storeu_ps(out[1] + f, _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1)));
+		}
+	}
+	return f;
+}
+
+static int toInt32Sse(const float * const * in, qint32 * out, int channels, int frames, Dither4 & d)
+{
+	const __m128 scale = _mm_set1_ps(Int32Pcm::scale());
+	const __m128 lo = _mm_set1_ps(-Int32Pcm::scale());
+	const __m128 hi = _mm_set1_ps(Int32Pcm::maximum());
+	int f = 0;
+	if (channels == 1)
+	{
+		for (; f + 4 <= frames; f += 4)
+		{
+			_mm_storeu_si128((__m128i *)(out + f), quantize(_mm_loadu_ps(in[0] + f), scale, lo, hi, d));
+		}
+	}
+	else if (channels == 2)
+	{
+		for (; f + 4 <= frames; f += 4)
+		{
+			const __m128 l = _mm_loadu_ps(in[0] + f);
+			const __m128 r = _mm_loadu_ps(in[1] + f);
+			_mm_storeu_si128((__m128i *)(out + 2 * f), quantize(_mm_unpacklo_ps(l, r), scale, lo, hi, d));
+			_mm_storeu_si128((__m128i *)(out + 2 * f + 4), quantize(_mm_unpackhi_ps(l, r), scale, lo, hi, d));
+		}
+	}
+	return f;
+}
+#endif
+
+#ifdef QVSTHOST_AVX2
+// 4 packed 24 bit samples <-> 4 int32, the loads read 16 bytes
+QVSTHOST_SSSE3_TARGET static inline __m128 load24(const quint8 * p, __m128 k)
+{
+	const __m128i v = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)p), _mm_setr_epi8(-1, 0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11));
+	return _mm_mul_ps(_mm_cvtepi32_ps(_mm_srai_epi32(v, 8)), k);
+}
+
+QVSTHOST_SSSE3_TARGET static inline void store24(quint8 * p, __m128i v)
+{
+	const __m128i b = _mm_shuffle_epi8(v, _mm_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1));
+	_mm_storel_epi64((__m128i *)p, b);
+	const int tail = _mm_cvtsi128_si32(_mm_srli_si128(b, 8));
+	memcpy(p + 8, & tail, 4);
+}
+
+QVSTHOST_SSSE3_TARGET static int fromInt24Ssse3(const quint8 * in, float * const * out, int channels, int frames)
+{
+	const __m128 k = _mm_set1_ps(1.0f / Int24Pcm::scale());
+	int f = 0;
+	if (channels == 1)
+	{
+		for (; 3 * f + 16 <= 3 * frames; f += 4)
+		{
+			_mm_storeu_ps(out[0] + f, load24(in + 3 * f, k));
+		}
+	}
+	else if (channels == 2)
+	{
+		for (; 6 * f + 28 <= 6 * frames; f += 4)
+		{
+			const __m128 a = load24(in + 6 * f, k);
+			const __m128 b = load24(in + 6 * f + 12, k);
+			_mm_storeu_ps(out[0] + f, _mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0)));
+			_mm_storeu_ps(out[1] + f, _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1)));
+		}
+	}
+	return f;
+}
+
+QVSTHOST_SSSE3_TARGET static int toInt24Ssse3(const float * const * in, quint8 * out, int channels, int frames, Dither4 & d)
+{
+	const __m128 scale = _mm_set1_ps(Int24Pcm::scale());
+	const __m128 lo = _mm_set1_ps(-Int24Pcm::scale());
+	const __m128 hi = _mm_set1_ps(Int24Pcm::maximum());
+	int f = 0;
+	if (channels == 1)
+	{
+		for (; f + 4 <= frames; f += 4)
+		{
+			store24(out + 3 * f, quantize(_mm_loadu_ps(in[0] + f), scale, lo, hi, d));
+		}
+	}
+	else if (channels == 2)
+	{
+		for (; f + 4 <= frames; f += 4)
+		{
+			const __m128 l = _mm_loadu_ps(in[0] + f);
+			const __m128 r = _mm_loadu_ps(in[1] + f);
+			store24(out + 6 * f, quantize(_mm_unpacklo_ps(l, r), scale, lo, hi, d));
+			store24(out + 6 * f + 12, quantize(_mm_unpackhi_ps(l, r), scale, lo, hi, d));
+		}
+	}
+	return f;
+}
+#endif
+
+void QVstSimd::fromInt16(const qint16 * in, float * const * out, int channels, int frames)
+{
+	int f = 0;
+#ifdef QVSTHOST_SSE2
+	f = fromInt16Sse(in, out, channels, frames);
+#endif
+	fromPcmAny<Int16Pcm>(in, out, channels, f, frames);
+}
+
+void QVstSimd::fromInt24(const quint8 * in, float * const * out, int channels, int frames)
+{
+	int f = 0;
+#ifdef QVSTHOST_AVX2
+	if (hasSsse3())
+	{
+		f = fromInt24Ssse3(in, out, channels, frames);
+	}
+#endif
+	fromPcmAny<Int24Pcm>(in, out, channels, f, frames);
+}
+
+void QVstSimd::fromInt32(const qint32 * in, float * const * out, int channels, int frames)
+{
+	int f = 0;
+#ifdef QVSTHOST_SSE2
+	f = fromInt32Sse(in, out, channels, frames);
+#endif
+	fromPcmAny<Int32Pcm>(in, out, channels, f, frames);
+}
+
+void QVstSimd::toInt16(const float * const * in, qint16 * out, int channels, int frames, quint32 * dither)
+{
+	int f = 0;
+#ifdef QVSTHOST_SSE2
+	Dither4 d(dither);
+	f = toInt16Sse(in, out, channels, frames, d);
+#endif
+	toPcmAny<Int16Pcm>(in, out, channels, f, frames, dither);
+}
+
+void QVstSimd::toInt24(const float * const * in, quint8 * out, int channels, int frames, quint32 * dither)
+{
+	int f = 0;
+#ifdef QVSTHOST_AVX2
+	if (hasSsse3())
+	{
+		Dither4 d(dither);
+		f = toInt24Ssse3(in, out, channels, frames, d);
+	}
+#endif
+	toPcmAny<Int24Pcm>(in, out, channels, f, frames, dither);
+}
+
+void QVstSimd::toInt32(const float * const * in, qint32 * out, int channels, int frames, quint32 * dither)
+{
+	int f = 0;
+#ifdef QVSTHOST_SSE2
+	Dither4 d(dither);
+	f = toInt32Sse(in, out, channels, frames, d);
+#endif
+	toPcmAny<Int32Pcm>(in, out, channels, f, frames, dither);
+}
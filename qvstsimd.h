@@ -0,0 +1,73 @@
+#ifndef QVSTSIMD_H
+#define QVSTSIMD_H
+
+#include <QtGlobal>
+
+// sample kernels used by the host, SSE2 with AVX2 selected at runtime
+class QVstSimd
+{
+public:
+// cpu
+	static bool hasSsse3();
+	static bool hasAvx2();
+
+// silence
+	static bool isSilent(const float *, int);
+	static bool isSilent(const double *, int);
+
+// denormals
+	static int denormals(const float *, int); // subnormal samples count
+	static int denormals(const double *, int);
+	static unsigned int flushDenormals(); // sets FTZ and DAZ, returns the previous MXCSR for restoreDenormals()
+	static void restoreDenormals(unsigned int);
+
+// precision
+	static void convert(const float *, double *, int);
+	static void convert(const double *, float *, int);
+	static void convert(const float *, float *, int);
+	static void convert(const double *, double *, int);
+
+// gain
+	static void scale(const float *, float *, float, int); // out = in * gain
+	static void scale(const double *, double *, double, int);
+	static void mix(const float *, float *, float, int); // out += in * gain
+	static void mix(const double *, double *, double, int);
+
+// interleaved <-> planar, specialized for 1, 2, 6 and 8 channels
+	static void deinterleave(const float *, float * const *, int, int); // channels, frames
+	static void deinterleave(const double *, double * const *, int, int);
+	static void interleave(const float * const *, float *, int, int);
+	static void interleave(const double * const *, double *, int, int);
+
+// interleaved integer pcm <-> planar float in [-1, 1), vectorized for 1 and 2 channels, 24 bits are packed little endian
+	static void fromInt16(const qint16 *, float * const *, int, int); // channels, frames
+	static void fromInt24(const quint8 *, float * const *, int, int);
+	static void fromInt32(const qint32 *, float * const *, int, int);
+	static void toInt16(const float * const *, qint16 *, int, int, quint32 * dither = 0); // TPDF dither generator state, NULL - no dither
+	static void toInt24(const float * const *, quint8 *, int, int, quint32 * dither = 0);
+	static void toInt32(const float * const *, qint32 *, int, int, quint32 * dither = 0);
+};
+
+// FTZ and DAZ for the scope, restores the previous mode
+class QVstDenormalGuard
+{
+	unsigned int state;
+	bool active;
+public:
+	explicit QVstDenormalGuard(bool enable = true): state(0), active(enable)
+	{
+		if (active)
+		{
+			state = QVstSimd::flushDenormals();
+		}
+	}
+	~QVstDenormalGuard()
+	{
+		if (active)
+		{
+			QVstSimd::restoreDenormals(state);
+		}
+	}
+};
+
+#endif // QVSTSIMD_H
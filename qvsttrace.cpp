@@ -0,0 +1,258 @@
+#include "qvsttrace.h"
+#include <QAtomicInt>
+#include <QAtomicPointer>
+#include <QElapsedTimer>
+#include <QFile>
+#include <stdio.h>
+
+#if defined(_MSC_VER)
+#define QVSTHOST_THREAD_LOCAL __declspec(thread)
+#else
+#define QVSTHOST_THREAD_LOCAL __thread
+#endif
+
+struct TraceEvent
+{
+	qint64 ts; // ns
+	const char * category;
+	const char * name;
+	int effect;
+	qint64 value;
+	char phase;
+};
+
+// written by its thread only, count is published with release
+struct TraceBuffer
+{
+	TraceEvent * events;
+	int capacity;
+	QAtomicInt count;
+	QAtomicInt claimed; // 0 - spare
+	int tid;
+	TraceBuffer * next;
+};
+
+enum
+{
+	SpareBuffers = 4 // kept allocated while enabled for threads that didn't register
+};
+
+static QAtomicInt trace_enabled;
+static QAtomicInt trace_capacity(1 << 16);
+static QAtomicInt trace_threads;
+static QAtomicInteger<qint64> trace_dropped;
+static QAtomicPointer<TraceBuffer> trace_buffers; // lock free push front list, never shrinks
+static QVSTHOST_THREAD_LOCAL TraceBuffer * trace_local = 0;
+static QElapsedTimer trace_clock;
+static const bool trace_clock_started = (trace_clock.start(), true);
+
+static TraceBuffer * allocateBuffer()
+{
+	TraceBuffer * b = new TraceBuffer();
+	b->capacity = qMax(16, trace_capacity.loadAcquire());
+	b->events = new TraceEvent[b->capacity];
+	b->tid = 0;
+	do
+	{
+		b->next = trace_buffers.loadAcquire();
+	}
+	while (!trace_buffers.testAndSetRelease(b->next, b));
+	return b;
+}
+
+// takes a spare buffer for the calling thread, no allocation
+static TraceBuffer * claimBuffer()
+{
+	for (TraceBuffer * b = trace_buffers.loadAcquire(); b; b = b->next)
+	{
+		if (b->claimed.testAndSetOrdered(0, 1))
+		{
+			b->tid = trace_threads.fetchAndAddOrdered(1) + 1;
+			trace_local = b;
+			return b;
+		}
+	}
+	return 0;
+}
+
+static void record(char phase, const char * category, const char * name, int effect, qint64 value)
+{
+	TraceBuffer * b = trace_local ? trace_local : claimBuffer();
+	if (!b)
+	{
+		trace_dropped.fetchAndAddRelaxed(1);
+		return;
+	}
+	const int n = b->count.load();
+	if (n >= b->capacity)
+	{
+		trace_dropped.fetchAndAddRelaxed(1);
+		return;
+	}
+	TraceEvent & e = b->events[n];
+	e.ts = trace_clock.nsecsElapsed();
+	e.category = category;
+	e.name = name;
+	e.effect = effect;
+	e.value = value;
+	e.phase = phase;
+	b->count.storeRelease(n + 1);
+}
+
+void QVstTrace::setEnabled(bool state)
+{
+	if (state)
+	{
+		int spare = 0;
+		for (TraceBuffer * b = trace_buffers.loadAcquire(); b; b = b->next)
+		{
+			spare += (b->claimed.load() == 0) ? 1 : 0;
+		}
+		for (; spare < SpareBuffers; spare++)
+		{
+			allocateBuffer();
+		}
+	}
+	trace_enabled.storeRelease(state ? 1 : 0);
+}
+
+void QVstTrace::registerThread()
+{
+	if (!trace_local && !claimBuffer())
+	{
+		allocateBuffer();
+		claimBuffer();
+	}
+}
+
+bool QVstTrace::isEnabled()
+{
+	return trace_enabled.loadAcquire() != 0;
+}
+
+void QVstTrace::setBufferSize(int events)
+{
+	trace_capacity.storeRelease(events);
+}
+
+void QVstTrace::clear()
+{
+	for (TraceBuffer * b = trace_buffers.loadAcquire(); b; b = b->next)
+	{
+		b->count.storeRelease(0);
+	}
+	trace_dropped.store(0);
+}
+
+qint64 QVstTrace::droppedCount()
+{
+	return trace_dropped.load();
+}
+
+void QVstTrace::begin(const char * category, const char * name, int effect, qint64 value)
+{
+	record('B', category, name, effect, value);
+}
+
+void QVstTrace::end(const char * category, const char * name)
+{
+	record('E', category, name, 0, 0);
+}
+
+QByteArray QVstTrace::toJson()
+{
+	QByteArray json("{\"traceEvents\":[\n");
+	char line[512];
+	bool first = true;
+	for (TraceBuffer * b = trace_buffers.loadAcquire(); b; b = b->next)
+	{
+		if (b->claimed.loadAcquire() == 0)
+		{
+			continue;
+		}
+		const int count = b->count.loadAcquire();
+		int n = qsnprintf(line, sizeof(line), "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"thread %d\"}}",
+			first ? "" : ",\n", b->tid, b->tid);
+		json.append(line, n);
+		first = false;
+		for (int i = 0; i < count; i++)
+		{
+			const TraceEvent & e = b->events[i];
+			if (e.phase == 'B')
+			{
+				n = qsnprintf(line, sizeof(line), ",\n{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"B\",\"ts\":%lld.%03d,\"pid\":1,\"tid\":%d,\"args\":{\"effect\":\"%08x\",\"value\":%lld}}",
+					e.name, e.category, e.ts / 1000, (int)(e.ts % 1000), b->tid, (unsigned int)e.effect, e.value);
+			}
+			else
+			{
+				n = qsnprintf(line, sizeof(line), ",\n{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"E\",\"ts\":%lld.%03d,\"pid\":1,\"tid\":%d}",
+					e.name, e.category, e.ts / 1000, (int)(e.ts % 1000), b->tid);
+			}
+			json.append(line, qMin(n, (int)sizeof(line) - 1));
+		}
+	}
+	json.append("\n],\"displayTimeUnit\":\"ns\"}\n");
+	return json;
+}
+
+bool QVstTrace::save(const QString & name)
+{
+	QFile f(name);
+	if (!f.open(QIODevice::WriteOnly | QIODevice::Truncate))
+	{
+		return false;
+	}
+	const QByteArray json = toJson();
+	return (f.write(json) == json.size());
+}
+
+// opcode names
+
+static const char * const effect_opcodes[] =
+{
+	"effOpen", "effClose", "effSetProgram", "effGetProgram", "effSetProgramName", "effGetProgramName",
+	"effGetParamLabel", "effGetParamDisplay", "effGetParamName", "effGetVu", "effSetSampleRate", "effSetBlockSize",
+	"effMainsChanged", "effEditGetRect", "effEditOpen", "effEditClose", "effEditDraw", "effEditMouse",
+	"effEditKey", "effEditIdle", "effEditTop", "effEditSleep", "effIdentify", "effGetChunk",
+	"effSetChunk", "effProcessEvents", "effCanBeAutomated", "effString2Parameter", "effGetNumProgramCategories", "effGetProgramNameIndexed",
+	"effCopyProgram", "effConnectInput", "effConnectOutput", "effGetInputProperties", "effGetOutputProperties", "effGetPlugCategory",
+	"effGetCurrentPosition", "effGetDestinationBuffer", "effOfflineNotify", "effOfflinePrepare", "effOfflineRun", "effProcessVarIo",
+	"effSetSpeakerArrangement", "effSetBlockSizeAndSampleRate", "effSetBypass", "effGetEffectName", "effGetErrorText", "effGetVendorString",
+	"effGetProductString", "effGetVendorVersion", "effVendorSpecific", "effCanDo", "effGetTailSize", "effIdle",
+	"effGetIcon", "effSetViewPosition", "effGetParameterProperties", "effKeysRequired", "effGetVstVersion", "effEditKeyDown",
+	"effEditKeyUp", "effSetEditKnobMode", "effGetMidiProgramName", "effGetCurrentMidiProgram", "effGetMidiProgramCategory", "effHasMidiProgramsChanged",
+	"effGetMidiKeyName", "effBeginSetProgram", "effEndSetProgram", "effGetSpeakerArrangement", "effShellGetNextPlugin", "effStartProcess",
+	"effStopProcess", "effSetTotalSampleToProcess", "effSetPanLaw", "effBeginLoadBank", "effBeginLoadProgram", "effSetProcessPrecision",
+	"effGetNumMidiInputChannels", "effGetNumMidiOutputChannels"
+};
+
+static const char * const host_opcodes[] =
+{
+	"audioMasterAutomate", "audioMasterVersion", "audioMasterCurrentId", "audioMasterIdle", "audioMasterPinConnected", "audioMaster5",
+	"audioMasterWantMidi", "audioMasterGetTime", "audioMasterProcessEvents", "audioMasterSetTime", "audioMasterTempoAt", "audioMasterGetNumAutomatableParameters",
+	"audioMasterGetParameterQuantization", "audioMasterIOChanged", "audioMasterNeedIdle", "audioMasterSizeWindow", "audioMasterGetSampleRate", "audioMasterGetBlockSize",
+	"audioMasterGetInputLatency", "audioMasterGetOutputLatency", "audioMasterGetPreviousPlug", "audioMasterGetNextPlug", "audioMasterWillReplaceOrAccumulate", "audioMasterGetCurrentProcessLevel",
+	"audioMasterGetAutomationState", "audioMasterOfflineStart", "audioMasterOfflineRead", "audioMasterOfflineWrite", "audioMasterOfflineGetCurrentPass", "audioMasterOfflineGetCurrentMetaPass",
+	"audioMasterSetOutputSampleRate", "audioMasterGetOutputSpeakerArrangement", "audioMasterGetVendorString", "audioMasterGetProductString", "audioMasterGetVendorVersion", "audioMasterVendorSpecific",
+	"audioMasterSetIcon", "audioMasterCanDo", "audioMasterGetLanguage", "audioMasterOpenWindow", "audioMasterCloseWindow", "audioMasterGetDirectory",
+	"audioMasterUpdateDisplay", "audioMasterBeginEdit", "audioMasterEndEdit", "audioMasterOpenFileSelector", "audioMasterCloseFileSelector", "audioMasterEditFile",
+	"audioMasterGetChunkFile", "audioMasterGetInputSpeakerArrangement"
+};
+
+const char * QVstTrace::opcodeName(int opcode)
+{
+	if (opcode < 0 || opcode >= (int)(sizeof(effect_opcodes) / sizeof(effect_opcodes[0])))
+	{
+		return "dispatcher";
+	}
+	return effect_opcodes[opcode];
+}
+
+const char * QVstTrace::hostOpcodeName(int opcode)
+{
+	if (opcode < 0 || opcode >= (int)(sizeof(host_opcodes) / sizeof(host_opcodes[0])))
+	{
+		return "audioMaster";
+	}
+	return host_opcodes[opcode];
+}
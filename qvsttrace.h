@@ -0,0 +1,56 @@
+#ifndef QVSTTRACE_H
+#define QVSTTRACE_H
+
+#include <QtGlobal>
+#include <QString>
+#include <QByteArray>
+
+// host activity in Chrome trace event format (chrome://tracing, ui.perfetto.dev),
+// every thread records into its own lock free buffer: registerThread() allocates one for the calling thread,
+// threads that didn't register claim one of the spare buffers setEnabled(true) keeps allocated at their first event,
+// recording never allocates, events of threads left without a buffer are dropped
+class QVstTrace
+{
+public:
+// control
+	static void setEnabled(bool);
+	static bool isEnabled();
+	static void setBufferSize(int); // events per thread, for buffers allocated afterwards
+	static void registerThread(); // call from every audio thread before it processes, allocates
+	static void clear(); // drops recorded events, call while no thread is recording
+	static qint64 droppedCount(); // events lost to full buffers
+
+// export
+	static QByteArray toJson();
+	static bool save(const QString &); // file name
+
+// recording, names and categories must be static strings
+	static void begin(const char * category, const char * name, int effect = 0, qint64 value = 0); // effect - AEffect::uniqueID
+	static void end(const char * category, const char * name);
+	static const char * opcodeName(int); // AEffect dispatcher opcode
+	static const char * hostOpcodeName(int); // audioMaster opcode
+
+	class Scope
+	{
+		const char * category;
+		const char * name;
+		bool active;
+	public:
+		Scope(const char * c, const char * n, int effect = 0, qint64 value = 0): category(c), name(n), active(isEnabled())
+		{
+			if (active)
+			{
+				begin(category, name, effect, value);
+			}
+		}
+		~Scope()
+		{
+			if (active)
+			{
+				end(category, name);
+			}
+		}
+	};
+};
+
+#endif // QVSTTRACE_H
@@ -0,0 +1,71 @@
+// runs a chain of in process mock effects under the auditor, built with QVSTHOST_AUDIT,
+// fails if the host allocates, frees or locks on any of the realtime process entry points
+#include <QVector>
+#include <stdio.h>
+#include "../qvsthost.h"
+#include "../qvstmock.h"
+#include "../qvstaudit.h"
+
+static const int Channels = 2;
+static const int Frames = 256;
+
+int main()
+{
+	if (!QVstAudit::isAvailable())
+	{
+		fprintf(stderr, "built without QVSTHOST_AUDIT\n");
+		return 1;
+	}
+	QVstMock::Config delayed;
+	delayed.latency = 10;
+	QVstChain chain;
+	chain << QVstMock::create() << QVstMock::create(delayed) << QVstMock::create();
+	chain.setSampleRate(48000);
+	chain.setBlockSize(Frames);
+	chain.resume();
+
+	QVstAudioBuffer<float> fin(Channels, Frames);
+	QVstAudioBuffer<float> fout(Channels, Frames);
+	QVstAudioBuffer<double> din(Channels, Frames);
+	QVstAudioBuffer<double> dout(Channels, Frames);
+	QVector<const float *> fsrc(Channels);
+	QVector<float *> fdst(Channels);
+	for (int k = 0; k < Channels; k++)
+	{
+		fsrc[k] = fin.channel(k);
+		fdst[k] = fout.channel(k);
+	}
+	QVector<float> interleaved(Channels * Frames, 0.25f);
+	QVector<float> finterleaved(Channels * Frames);
+	QVector<qint16> pcm(Channels * Frames, 1000);
+	QVector<qint16> pcmout(Channels * Frames);
+	QVector<float> one(Frames, 0.25f);
+	QVector<float> oneout(Frames);
+
+	bool ok = true;
+	QVstAudit::setEnabled(true);
+	for (int i = 0; i < 100; i++)
+	{
+		ok = chain.process(fsrc.data(), fdst.data(), Channels, Frames) && ok;
+		ok = chain.process(fin, fout) && ok;
+		ok = chain.process(din, dout) && ok;
+		ok = chain.processInterleaved(interleaved.constData(), finterleaved.data(), Channels, Frames) && ok;
+		ok = chain.processPcm(pcm.constData(), QVstChain::Int16, pcmout.data(), QVstChain::Int16, Channels, Frames) && ok;
+		ok = chain.processOne(one, oneout) && ok;
+	}
+	QVstAudit::setEnabled(false);
+
+	foreach (const QVstAudit::Counts & c, QVstAudit::counts())
+	{
+		if (c.allocations || c.deallocations || c.locks)
+		{
+			fprintf(stderr, "%s, stage %d: %lld allocations, %lld deallocations, %lld locks\n", c.stage, c.index, c.allocations, c.deallocations, c.locks);
+		}
+	}
+	if (!ok)
+	{
+		fprintf(stderr, "processing failed\n");
+		return 1;
+	}
+	return QVstAudit::violationsCount() == 0 ? 0 : 1;
+}
@@ -0,0 +1,403 @@
+// host behaviour over in process mock effects, output samples and counters, no plugin binaries needed
+#include <QVector>
+#include <QList>
+#include <stdio.h>
+#include <math.h>
+#include <string.h>
+#include "../qvsthost.h"
+#include "../qvstmock.h"
+#include "../qvstrender.h"
+
+static int failures = 0;
+
+#define CHECK(x) check((x), #x, __LINE__)
+
+static void check(bool ok, const char * what, int line)
+{
+	if (!ok)
+	{
+		fprintf(stderr, "hosttest.cpp:%d: %s\n", line, what);
+		failures++;
+	}
+}
+
+static bool near(double a, double b)
+{
+	return fabs(a - b) < 1e-6;
+}
+
+// 0, 1, 2... so delays show up as an offset
+static QVector<float> ramp(int count, int start = 0)
+{
+	QVector<float> v(count);
+	for (int n = 0; n < count; n++)
+	{
+		v[n] = (float)(start + n);
+	}
+	return v;
+}
+
+static QVstMock::Config gain(float g, int latency = 0)
+{
+	QVstMock::Config c;
+	c.gain = g;
+	c.latency = latency;
+	return c;
+}
+
+static void prepare(QVstChain & chain, int block)
+{
+	chain.setSampleRate(48000);
+	chain.setBlockSize(block);
+	chain.resume();
+}
+
+static void testGains()
+{
+	QVstChain chain;
+	chain << QVstMock::create(gain(2.0f)) << QVstMock::create(gain(0.5f)) << QVstMock::create(gain(3.0f));
+	prepare(chain, 64);
+	const QVector<float> in = ramp(100);
+	QVector<float> out;
+	CHECK(chain.processOne(in, out));
+	CHECK(out.count() == 100);
+	bool ok = true;
+	for (int n = 0; n < out.count(); n++)
+	{
+		ok = ok && near(out[n], 3.0 * n);
+	}
+	CHECK(ok);
+}
+
+static void testLatency()
+{
+	QVstChain chain;
+	chain << QVstMock::create(gain(1.0f, 10)) << QVstMock::create(gain(1.0f, 7));
+	prepare(chain, 64);
+	CHECK(chain.latency() == 17);
+	const QVector<float> in = ramp(100, 1);
+	QVector<float> out;
+	CHECK(chain.processOne(in, out));
+	bool ok = true;
+	for (int n = 0; n < out.count(); n++)
+	{
+		ok = ok && near(out[n], n < 17 ? 0.0 : in[n - 17]);
+	}
+	CHECK(ok);
+}
+
+// host bypass plays the input delayed by latency(), the dry line is fed while the plugin is active
+static void testBypass()
+{
+	QVstChain chain;
+	chain << QVstMock::create(gain(1.0f, 10));
+	prepare(chain, 32);
+	CHECK(chain.latency() == 10);
+	QVector<float> out;
+	bool ok = true;
+	for (int pass = 0; pass < 2; pass++)
+	{
+		const int start = 1 + pass * 200;
+		CHECK(chain.processOne(ramp(100, start), out));
+		chain[0].setHostBypass(true);
+		CHECK(chain.processOne(ramp(100, start + 100), out));
+		for (int n = 0; n < out.count(); n++)
+		{
+			ok = ok && near(out[n], start + 90 + n);
+		}
+		chain[0].setHostBypass(false);
+	}
+	CHECK(ok);
+}
+
+// swapped and inserted plugins take the neighbour's settings and the chain's precision
+static void testHotSwap()
+{
+	QVstChain chain;
+	chain << QVstMock::create(gain(2.0f)) << QVstMock::create(gain(3.0f));
+	chain.setDoublePrecision(true);
+	chain[1].setFlushDenormals(true);
+	chain[1].setBypassCrossfade(16);
+	prepare(chain, 32);
+	CHECK(chain.hotReplace(1, QVstMock::create(gain(5.0f))));
+	CHECK(chain.hotInsert(2, QVstMock::create(gain(0.5f))));
+	CHECK(chain.count() == 3);
+	for (int k = 1; k < chain.count(); k++)
+	{
+		CHECK(!chain[k].isSuspended() && chain[k].blockSize() == 32 && chain[k].doublePrecision());
+		CHECK(chain[k].flushDenormals() && chain[k].bypassCrossfade() == 16);
+	}
+	const QVector<double> in(50, 1.0);
+	QVector<double> out;
+	CHECK(chain.processOne(in, out));
+	CHECK(out.count() == 50 && near(out[0], 5.0) && near(out[49], 5.0));
+	CHECK(chain.hotRemove(0));
+	CHECK(chain.processOne(in, out) && near(out[0], 2.5));
+}
+
+// QVector outputs drop the leading latency() samples once, the pointer entry points aren't trimmed
+static void testLatencyTrim()
+{
+	QVstChain chain;
+	chain << QVstMock::create(gain(1.0f, 10));
+	prepare(chain, 32);
+	chain.setLatencyCompensation(true);
+	QVector<float> out;
+	CHECK(chain.processOne(ramp(100, 1), out));
+	CHECK(out.count() == 90 && near(out[0], 1.0) && near(out[89], 90.0));
+	CHECK(chain.processOne(ramp(100, 101), out));
+	CHECK(out.count() == 100 && near(out[0], 91.0));
+
+	QVstChain list;
+	list << QVstMock::create(gain(2.0f, 10));
+	prepare(list, 32);
+	list.setLatencyCompensation(true);
+	const QList< QVector<float> > l = list.process(QList< QVector<float> >() << ramp(50, 1) << ramp(50, 1));
+	CHECK(l.count() == 2 && l[1].count() == 40 && near(l[1][0], 2.0));
+
+	QVstChain raw;
+	raw << QVstMock::create(gain(1.0f, 10));
+	prepare(raw, 32);
+	raw.setLatencyCompensation(true);
+	QVstAudioBuffer<float> in(2, 32);
+	QVstAudioBuffer<float> o(2, 32);
+	in.channel(0)[0] = 1.0f;
+	CHECK(raw.process(in, o));
+	CHECK(near(o.channel(0)[10], 1.0) && near(o.channel(0)[0], 0.0));
+}
+
+// a plugin is skipped once its input has been silent for its tail plus latency, and restarts clean
+static void testSilenceSkipping()
+{
+	QVstMock::Config c = gain(1.0f, 10);
+	c.tail = 20;
+	QVstChain chain;
+	chain << QVstMock::create(c);
+	chain.setSilenceSkipping(true);
+	chain.setProfiling(true);
+	prepare(chain, 16);
+	QVector<float> out;
+	CHECK(chain.processOne(QVector<float>(16, 1.0f), out));
+	CHECK(near(out[9], 0.0) && near(out[10], 1.0));
+	CHECK(chain.processOne(QVector<float>(16, 0.0f), out));
+	CHECK(near(out[9], 1.0) && near(out[10], 0.0));
+	for (int i = 0; i < 4; i++)
+	{
+		CHECK(chain.processOne(QVector<float>(16, 0.0f), out));
+	}
+	CHECK(chain.processStats().at(0).calls == 3); // 30 silent frames before the third silent block
+	CHECK(chain.processOne(ramp(16, 1), out));
+	CHECK(chain.processStats().at(0).calls == 4);
+	CHECK(near(out[9], 0.0) && near(out[10], 1.0) && near(out[15], 6.0));
+}
+
+// copies and moves share the instance, clones load a new one
+static void testLoadsCount()
+{
+	const int loads = QVstPlugin::loadsCount();
+	QVstPlugin a = QVstMock::create();
+	CHECK(QVstPlugin::loadsCount() == loads + 1);
+	QVstPlugin b = a;
+	CHECK(a.isShared() && b.isLoaded());
+	QVstPlugin c(static_cast<QVstPlugin &&>(b));
+	CHECK(c.isLoaded() && !b.isLoaded());
+	QVstChain chain;
+	chain << a << QVstMock::create();
+	QVstChain copy = chain;
+	CHECK(copy.count() == 2 && QVstPlugin::loadsCount() == loads + 2);
+	QVstChain cloned = chain.clone();
+	CHECK(cloned.count() == 2 && QVstPlugin::loadsCount() == loads + 4);
+}
+
+// pin gains from the chain inputs into the first plugin
+static void testRouting()
+{
+	QVstChain chain;
+	chain << QVstMock::create() << QVstMock::create();
+	QList< QVector<float> > matrix;
+	matrix << (QVector<float>() << 0.5f << 0.5f) << (QVector<float>() << 1.0f << 0.0f);
+	chain.setRouting(1, matrix);
+	prepare(chain, 32);
+	const QList< QVector<float> > out = chain.process(QList< QVector<float> >() << QVector<float>(40, 1.0f) << QVector<float>(40, 3.0f));
+	CHECK(out.count() == 2);
+	CHECK(out.count() == 2 && near(out[0][0], 2.0) && near(out[0][39], 2.0) && near(out[1][0], 1.0) && near(out[1][39], 1.0));
+	CHECK(chain.routing(1) == matrix);
+}
+
+// the chain fifo delays by exactly blockSize() whatever the call lengths
+static void testFixedBlock()
+{
+	QVstChain chain;
+	chain << QVstMock::create(gain(1.0f, 5));
+	chain.setFixedBlock(true);
+	prepare(chain, 32);
+	CHECK(chain.latency() == 37);
+	const int lengths[] = { 7, 13, 1, 32, 50, 17 };
+	QVector<float> all;
+	int start = 1;
+	for (int i = 0; i < (int)(sizeof(lengths) / sizeof(lengths[0])); i++)
+	{
+		QVector<float> out;
+		CHECK(chain.processOne(ramp(lengths[i], start), out));
+		CHECK(out.count() == lengths[i]);
+		all += out;
+		start += lengths[i];
+	}
+	bool ok = true;
+	for (int n = 0; n < all.count(); n++)
+	{
+		ok = ok && near(all[n], n < 37 ? 0.0 : n - 36);
+	}
+	CHECK(ok);
+}
+
+// one overrun per process() call, the slow plugin is blamed
+static void testDeadlines()
+{
+	QVstMock::Config slow;
+	slow.callCost = 3000000;
+	QVstChain chain;
+	chain << QVstMock::create() << QVstMock::create(slow);
+	prepare(chain, 64);
+	chain.setDeadlineMonitor(true);
+	QVector<float> in(2 * 256);
+	QVector<float> out(2 * 256);
+	for (int i = 0; i < 3; i++)
+	{
+		CHECK(chain.processInterleaved(in.constData(), out.data(), 2, 64));
+	}
+	CHECK(chain.processInterleaved(in.constData(), out.data(), 2, 256));
+	CHECK(chain.overrunsCount() == 4);
+	QVstChain::Overrun o;
+	for (int i = 0; i < 4; i++)
+	{
+		CHECK(chain.takeOverrun(o) && o.block == i && o.stage == 1 && o.elapsed > o.budget);
+	}
+	CHECK(o.frames == 256 && o.stageElapsed >= 4 * slow.callCost);
+	CHECK(!chain.takeOverrun(o));
+	chain.setDeadlineMonitor(false);
+	CHECK(chain.processInterleaved(in.constData(), out.data(), 2, 64) && chain.overrunsCount() == 4);
+}
+
+static void put16(FILE * f, int v)
+{
+	const unsigned char b[2] = { (unsigned char)v, (unsigned char)(v >> 8) };
+	fwrite(b, 1, 2, f);
+}
+
+static void put32(FILE * f, qint64 v)
+{
+	put16(f, (int)(v & 0xffff));
+	put16(f, (int)((v >> 16) & 0xffff));
+}
+
+// 16 bit stereo pcm, left n, right -n
+static bool writeWav(const char * path, int frames)
+{
+	FILE * f = fopen(path, "wb");
+	if (!f)
+	{
+		return false;
+	}
+	fwrite("RIFF", 1, 4, f);
+	put32(f, 36 + frames * 4);
+	fwrite("WAVEfmt ", 1, 8, f);
+	put32(f, 16);
+	put16(f, 1);
+	put16(f, 2);
+	put32(f, 48000);
+	put32(f, 48000 * 4);
+	put16(f, 4);
+	put16(f, 16);
+	fwrite("data", 1, 4, f);
+	put32(f, frames * 4);
+	for (int n = 0; n < frames; n++)
+	{
+		put16(f, n);
+		put16(f, -n);
+	}
+	return fclose(f) == 0;
+}
+
+// the data chunk samples
+static QVector<qint16> readWav(const char * path)
+{
+	QVector<qint16> samples;
+	FILE * f = fopen(path, "rb");
+	if (!f)
+	{
+		return samples;
+	}
+	unsigned char header[12];
+	unsigned char chunk[8];
+	if (fread(header, 1, 12, f) == 12)
+	{
+		while (fread(chunk, 1, 8, f) == 8)
+		{
+			const long size = chunk[4] | (chunk[5] << 8) | (chunk[6] << 16) | ((long)chunk[7] << 24);
+			if (memcmp(chunk, "data", 4) != 0)
+			{
+				fseek(f, size + (size & 1), SEEK_CUR);
+				continue;
+			}
+			QVector<unsigned char> raw(size);
+			if (fread(raw.data(), 1, size, f) == (size_t)size)
+			{
+				for (int i = 0; i + 1 < size; i += 2)
+				{
+					samples << (qint16)(raw[i] | (raw[i + 1] << 8));
+				}
+			}
+			break;
+		}
+	}
+	fclose(f);
+	return samples;
+}
+
+// latency trimmed, same length out, the chain is left suspended
+static void testRender()
+{
+	const int frames = 1000;
+	CHECK(writeWav("hosttest_in.wav", frames));
+	QVstChain chain;
+	chain << QVstMock::create(gain(2.0f, 10));
+	QVstRenderer renderer(chain);
+	renderer.setBlockSize(64);
+	CHECK(renderer.render("hosttest_in.wav", "hosttest_out.wav"));
+	CHECK(renderer.framesRead() == frames && renderer.framesWritten() == frames && renderer.sampleRate() == 48000);
+	CHECK(chain[0].isSuspended());
+	const QVector<qint16> out = readWav("hosttest_out.wav");
+	CHECK(out.count() == frames * 2);
+	bool ok = out.count() == frames * 2;
+	for (int n = 0; ok && n < frames; n++)
+	{
+		ok = out[2 * n] == 2 * n && out[2 * n + 1] == -2 * n;
+	}
+	CHECK(ok);
+	CHECK(!renderer.render("hosttest_missing.wav", "hosttest_out2.wav"));
+	CHECK(!fopen("hosttest_out2.wav", "rb"));
+	remove("hosttest_in.wav");
+	remove("hosttest_out.wav");
+}
+
+int main()
+{
+	testGains();
+	testLatency();
+	testBypass();
+	testHotSwap();
+	testLatencyTrim();
+	testSilenceSkipping();
+	testLoadsCount();
+	testRouting();
+	testFixedBlock();
+	testDeadlines();
+	testRender();
+	if (failures)
+	{
+		fprintf(stderr, "%d checks failed\n", failures);
+		return 1;
+	}
+	return 0;
+}
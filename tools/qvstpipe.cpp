@@ -0,0 +1,292 @@
+// raw pcm filter for shell pipelines: decoder | qvstpipe preset.ini | encoder
+// usage: qvstpipe <preset.ini> [channels] [sample rate] [block frames] [input format] [output format]
+// formats: f32 (float), s16, s24 (packed), s32, interleaved little endian, defaults: 2 48000 512 f32 <input format>
+// stdin is read and stdout is written on their own threads through two buffers each, so io overlaps processing
+// at the end of input latency plus tail frames of silence go through the chain, so the output keeps the delayed signal and the tails
+#include <QCoreApplication>
+#include <QStringList>
+#include <QThreadPool>
+#include <QRunnable>
+#include <QSemaphore>
+#include <QVector>
+#include <stdio.h>
+#include <string.h>
+#if defined(_WIN32)
+#include <io.h>
+#include <fcntl.h>
+#endif
+#include "../qvsthost.h"
+#include "../qvstsimd.h"
+
+enum SampleFormat
+{
+	Float32,
+	Int16,
+	Int24,
+	Int32
+};
+
+static bool parseFormat(const QString & s, SampleFormat & format)
+{
+	if (s == "f32")
+	{
+		format = Float32;
+	}
+	else if (s == "s16")
+	{
+		format = Int16;
+	}
+	else if (s == "s24")
+	{
+		format = Int24;
+	}
+	else if (s == "s32")
+	{
+		format = Int32;
+	}
+	else
+	{
+		return false;
+	}
+	return true;
+}
+
+static int sampleBytes(SampleFormat format)
+{
+	return (format == Int16) ? 2 : (format == Int24 ? 3 : 4);
+}
+
+static void decode(SampleFormat format, const char * raw, float * const * out, int channels, int frames)
+{
+	switch (format)
+	{
+	case Float32:
+		QVstSimd::deinterleave((const float *)raw, out, channels, frames);
+		break;
+	case Int16:
+		QVstSimd::fromInt16((const qint16 *)raw, out, channels, frames);
+		break;
+	case Int24:
+		QVstSimd::fromInt24((const quint8 *)raw, out, channels, frames);
+		break;
+	case Int32:
+		QVstSimd::fromInt32((const qint32 *)raw, out, channels, frames);
+		break;
+	}
+}
+
+static void encode(SampleFormat format, const float * const * in, char * raw, int channels, int frames)
+{
+	switch (format)
+	{
+	case Float32:
+		QVstSimd::interleave(in, (float *)raw, channels, frames);
+		break;
+	case Int16:
+		QVstSimd::toInt16(in, (qint16 *)raw, channels, frames);
+		break;
+	case Int24:
+		QVstSimd::toInt24(in, (quint8 *)raw, channels, frames);
+		break;
+	case Int32:
+		QVstSimd::toInt32(in, (qint32 *)raw, channels, frames);
+		break;
+	}
+}
+
+// frames the plugins ring out after the input stops, unknown tails count as none
+static int tailFrames(const QVstChain & chain)
+{
+	int frames = 0;
+	foreach (const QVstPlugin & vst, chain)
+	{
+		const int t = vst.tailSize();
+		frames += (t > 1) ? t : 0;
+	}
+	return frames;
+}
+
+// two buffers passed between a producer and a consumer, bytes 0 - end of stream
+struct DoubleBuffer
+{
+	QVector<char> data[2];
+	int bytes[2];
+	QSemaphore free;
+	QSemaphore full;
+	DoubleBuffer(int size): free(2)
+	{
+		for (int i = 0; i < 2; i++)
+		{
+			data[i] = QVector<char>(size);
+			bytes[i] = 0;
+		}
+	}
+};
+
+// fills the input buffers with whole frames
+class Reader: public QRunnable
+{
+	DoubleBuffer & buffer;
+	int frame;
+public:
+	Reader(DoubleBuffer & b, int f): buffer(b), frame(f)
+	{
+		setAutoDelete(false);
+	}
+	void run()
+	{
+		for (int i = 0; ; i ^= 1)
+		{
+			buffer.free.acquire();
+			const int n = (int)fread(buffer.data[i].data(), 1, buffer.data[i].count(), stdin);
+			buffer.bytes[i] = n - n % frame;
+			buffer.full.release();
+			if (buffer.bytes[i] == 0)
+			{
+				return;
+			}
+		}
+	}
+};
+
+class Writer: public QRunnable
+{
+	DoubleBuffer & buffer;
+public:
+	bool failed;
+	Writer(DoubleBuffer & b): buffer(b), failed(false)
+	{
+		setAutoDelete(false);
+	}
+	void run()
+	{
+		for (int i = 0; ; i ^= 1)
+		{
+			buffer.full.acquire();
+			const int n = buffer.bytes[i];
+			if (n > 0 && !failed)
+			{
+				failed = (fwrite(buffer.data[i].constData(), 1, n, stdout) != (size_t)n || fflush(stdout) != 0);
+			}
+			buffer.free.release();
+			if (n == 0)
+			{
+				return;
+			}
+		}
+	}
+};
+
+int main(int argc, char ** argv)
+{
+	QCoreApplication app(argc, argv);
+	const QStringList args = app.arguments();
+	if (args.count() < 2)
+	{
+		fprintf(stderr, "usage: qvstpipe <preset.ini> [channels] [sample rate] [block frames] [input format] [output format]\n");
+		return 2;
+	}
+	const int channels = args.count() > 2 ? args[2].toInt() : 2;
+	const int rate = args.count() > 3 ? args[3].toInt() : 48000;
+	const int block = args.count() > 4 ? args[4].toInt() : 512;
+	SampleFormat in_format = Float32;
+	if (args.count() > 5 && !parseFormat(args[5], in_format))
+	{
+		fprintf(stderr, "unknown format %s\n", qPrintable(args[5]));
+		return 2;
+	}
+	SampleFormat out_format = in_format;
+	if (args.count() > 6 && !parseFormat(args[6], out_format))
+	{
+		fprintf(stderr, "unknown format %s\n", qPrintable(args[6]));
+		return 2;
+	}
+	if (channels < 1 || rate < 1 || block < 1)
+	{
+		fprintf(stderr, "bad channels, sample rate or block size\n");
+		return 2;
+	}
+
+	QVstChain chain(args[1]);
+	if (chain.isEmpty() || !chain.canProcessFloat() || !chain.canProcess(channels))
+	{
+		fprintf(stderr, "can't load %s for %d channels\n", qPrintable(args[1]), channels);
+		return 1;
+	}
+	chain.setSampleRate(rate);
+	chain.setBlockSize(block);
+	chain.resume();
+
+#if defined(_WIN32)
+	_setmode(_fileno(stdin), _O_BINARY);
+	_setmode(_fileno(stdout), _O_BINARY);
+#endif
+	const int in_frame = channels * sampleBytes(in_format);
+	const int out_frame = channels * sampleBytes(out_format);
+	QVstAudioBuffer<float> in(channels, block);
+	QVstAudioBuffer<float> out(channels, block);
+	QVector<const float *> inptr(channels);
+	QVector<float *> outptr(channels);
+	for (int k = 0; k < channels; k++)
+	{
+		inptr[k] = in.channel(k);
+		outptr[k] = out.channel(k);
+	}
+	DoubleBuffer input(block * in_frame);
+	DoubleBuffer output(block * out_frame);
+	Reader reader(input, in_frame);
+	Writer writer(output);
+	QThreadPool pool;
+	pool.setMaxThreadCount(2);
+	pool.start(& reader);
+	pool.start(& writer);
+
+	bool ok = true;
+	int flush = -1; // silence left to process after the end of input, -1 - reading
+	for (int i = 0; ; i ^= 1)
+	{
+		int frames = 0;
+		if (flush < 0)
+		{
+			input.full.acquire();
+			frames = input.bytes[i] / in_frame;
+			if (frames > 0)
+			{
+				decode(in_format, input.data[i].constData(), (float * const *)inptr.constData(), channels, frames);
+			}
+			input.free.release();
+			if (frames == 0)
+			{
+				flush = chain.latency() + tailFrames(chain);
+				for (int k = 0; k < channels; k++)
+				{
+					memset(in.channel(k), 0, block * sizeof(float));
+				}
+			}
+		}
+		if (flush > 0)
+		{
+			frames = qMin(block, flush);
+			flush -= frames;
+		}
+		output.free.acquire();
+		if (frames > 0)
+		{
+			ok = ok && chain.process(inptr.data(), outptr.data(), channels, frames);
+			encode(out_format, outptr.constData(), output.data[i].data(), channels, frames);
+		}
+		output.bytes[i] = frames * out_frame;
+		output.full.release();
+		if (frames == 0)
+		{
+			break;
+		}
+	}
+	pool.waitForDone();
+	if (!ok)
+	{
+		fprintf(stderr, "processing failed\n");
+		return 1;
+	}
+	return writer.failed ? 1 : 0;
+}